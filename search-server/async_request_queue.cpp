@@ -0,0 +1,66 @@
+#include "async_request_queue.h"
+
+using namespace std;
+
+AsyncRequestQueue::AsyncRequestQueue(const SearchServer& search_server, ThreadPool& pool, size_t capacity, OverflowPolicy overflow_policy)
+    : search_server_(search_server)
+    , pool_(pool)
+    , capacity_(capacity)
+    , overflow_policy_(overflow_policy) {
+    if (capacity_ == 0) {
+        throw invalid_argument("Request queue capacity must be positive"s);
+    }
+}
+
+AsyncRequestQueue::~AsyncRequestQueue() {
+    unique_lock lock(mutex_);
+    slot_released_.wait(lock, [this] {
+        return pending_count_ == 0;
+    });
+}
+
+future<vector<Document>> AsyncRequestQueue::FindTopDocumentsAsync(string raw_query, DocumentStatus status) {
+    return Enqueue([this, raw_query = move(raw_query), status] {
+        return search_server_.FindTopDocuments(raw_query, status);
+    });
+}
+
+future<vector<Document>> AsyncRequestQueue::FindTopDocumentsAsync(string raw_query) {
+    return FindTopDocumentsAsync(move(raw_query), DocumentStatus::ACTUAL);
+}
+
+size_t AsyncRequestQueue::GetPendingCount() const {
+    lock_guard lock(mutex_);
+    return pending_count_;
+}
+
+size_t AsyncRequestQueue::GetRejectedCount() const {
+    lock_guard lock(mutex_);
+    return rejected_count_;
+}
+
+AsyncRequestQueue::Admission AsyncRequestQueue::Admit() {
+    unique_lock lock(mutex_);
+    if (pending_count_ >= capacity_) {
+        if (overflow_policy_ == OverflowPolicy::REJECT) {
+            ++rejected_count_;
+            return Admission::REJECTED;
+        }
+        // Место освобождают рабочие потоки пула: если ждёт один из них, все они могут оказаться заняты ожиданием
+        if (pool_.IsWorkerThread()) {
+            return Admission::INLINE;
+        }
+        slot_released_.wait(lock, [this] {
+            return pending_count_ < capacity_;
+        });
+    }
+    ++pending_count_;
+    return Admission::ACCEPTED;
+}
+
+void AsyncRequestQueue::Release() {
+    // Уведомление под блокировкой: иначе деструктор может уничтожить условную переменную раньше
+    lock_guard lock(mutex_);
+    --pending_count_;
+    slot_released_.notify_all();
+}
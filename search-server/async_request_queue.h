@@ -0,0 +1,121 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+#include "thread_pool.h"
+
+// Запрос отклонён, потому что очередь AsyncRequestQueue заполнена
+class QueueFullError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Асинхронный фронтенд SearchServer: запросы выполняются в пуле потоков,
+// а число принятых, но ещё не выполненных запросов ограничено capacity.
+// Когда очередь заполнена, запрос либо сразу отклоняется (future хранит QueueFullError),
+// либо вызывающий поток ждёт освобождения места — в зависимости от OverflowPolicy.
+// Рабочий поток того же пула не ждёт места, ведь его может освободить только он сам:
+// при политике WAIT такой запрос выполняется в нём сразу.
+// Сервер и пул должны пережить очередь; деструктор дожидается принятых запросов.
+class AsyncRequestQueue {
+public:
+    enum class OverflowPolicy {
+        REJECT,
+        WAIT,
+    };
+
+    AsyncRequestQueue(const SearchServer& search_server, ThreadPool& pool, std::size_t capacity, OverflowPolicy overflow_policy = OverflowPolicy::REJECT);
+
+    AsyncRequestQueue(const AsyncRequestQueue&) = delete;
+    AsyncRequestQueue& operator=(const AsyncRequestQueue&) = delete;
+
+    ~AsyncRequestQueue();
+
+    template <typename DocumentPredicate>
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query, DocumentPredicate document_predicate);
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query, DocumentStatus status);
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query);
+
+    // Принятые, но ещё не выполненные запросы
+    std::size_t GetPendingCount() const;
+    std::size_t GetRejectedCount() const;
+
+private:
+    const SearchServer& search_server_;
+    ThreadPool& pool_;
+    const std::size_t capacity_;
+    const OverflowPolicy overflow_policy_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable slot_released_;
+    std::size_t pending_count_ = 0;
+    std::size_t rejected_count_ = 0;
+
+    enum class Admission {
+        ACCEPTED,
+        REJECTED,
+        // Очередь заполнена, а ждать места нельзя: запрос выполняется в вызывающем потоке
+        INLINE,
+    };
+
+    // При ACCEPTED занимает место в очереди
+    Admission Admit();
+    void Release();
+
+    template <typename Search>
+    std::future<std::vector<Document>> Enqueue(Search search);
+};
+
+template <typename DocumentPredicate>
+std::future<std::vector<Document>> AsyncRequestQueue::FindTopDocumentsAsync(std::string raw_query, DocumentPredicate document_predicate) {
+    return Enqueue([this, raw_query = std::move(raw_query), document_predicate] {
+        return search_server_.FindTopDocuments(raw_query, document_predicate);
+    });
+}
+
+template <typename Search>
+std::future<std::vector<Document>> AsyncRequestQueue::Enqueue(Search search) {
+    using namespace std;
+
+    switch (Admit()) {
+        case Admission::REJECTED: {
+            promise<vector<Document>> rejected;
+            rejected.set_exception(make_exception_ptr(QueueFullError("Request queue is full"s)));
+            return rejected.get_future();
+        }
+        case Admission::INLINE: {
+            packaged_task<vector<Document>()> task(move(search));
+            auto result = task.get_future();
+            task();
+            return result;
+        }
+        case Admission::ACCEPTED:
+            break;
+    }
+    try {
+        return pool_.Submit([this, search = move(search)] {
+            // Место освобождается и при исключении в поиске
+            struct SlotGuard {
+                AsyncRequestQueue* queue;
+
+                ~SlotGuard() {
+                    queue->Release();
+                }
+            } guard{this};
+            return search();
+        });
+    } catch (...) {
+        // Задача не попала в пул и не запускалась, так что место не освободит никто, кроме нас
+        Release();
+        throw;
+    }
+}
@@ -0,0 +1,137 @@
+#include "binary_encoding.h"
+
+#include <array>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+array<uint32_t, 256> MakeCrc32Table() {
+    array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        uint32_t value = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            value = (value & 1) ? (value >> 1) ^ 0xedb88320u : value >> 1;
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+} // namespace
+
+void PutVarint(string& output, uint64_t value) {
+    while (value >= 0x80) {
+        output.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    output.push_back(static_cast<char>(value));
+}
+
+size_t GetVarintSize(uint64_t value) {
+    size_t size = 1;
+    for (; value >= 0x80; value >>= 7) {
+        ++size;
+    }
+    return size;
+}
+
+void PutSignedVarint(string& output, int64_t value) {
+    PutVarint(output, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void PutFixed32(string& output, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        output.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void PutFixed64(string& output, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        output.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void PutDouble(string& output, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    PutFixed64(output, bits);
+}
+
+void PutString(string& output, string_view value) {
+    PutVarint(output, value.size());
+    output.append(value);
+}
+
+uint32_t ComputeCrc32(string_view data) {
+    static const auto table = MakeCrc32Table();
+    uint32_t crc = 0xffffffffu;
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<unsigned char>(c)) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffu;
+}
+
+BinaryReader::BinaryReader(string_view data)
+    : data_(data) {
+}
+
+uint64_t BinaryReader::ReadVarint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const auto byte = static_cast<unsigned char>(ReadBytes(1).front());
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw CorruptedDataError("Varint is too long"s);
+}
+
+int64_t BinaryReader::ReadSignedVarint() {
+    const uint64_t value = ReadVarint();
+    return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+uint32_t BinaryReader::ReadFixed32() {
+    const string_view bytes = ReadBytes(4);
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+    }
+    return value;
+}
+
+uint64_t BinaryReader::ReadFixed64() {
+    const string_view bytes = ReadBytes(8);
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+    }
+    return value;
+}
+
+double BinaryReader::ReadDouble() {
+    const uint64_t bits = ReadFixed64();
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+string_view BinaryReader::ReadString() {
+    return ReadBytes(ReadVarint());
+}
+
+string_view BinaryReader::ReadBytes(size_t size) {
+    if (size > data_.size()) {
+        throw CorruptedDataError("Unexpected end of data"s);
+    }
+    const string_view bytes = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return bytes;
+}
+
+bool BinaryReader::empty() const {
+    return data_.empty();
+}
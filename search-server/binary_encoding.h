@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Двоичные данные журнала или контрольной точки обрываются или не сходятся с контрольной суммой
+class CorruptedDataError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Компактный двоичный формат журнала и контрольных точек: целые без знака — varint,
+// со знаком — zigzag varint, строки — длина и байты, числа фиксированной длины — little-endian
+void PutVarint(std::string& output, std::uint64_t value);
+// Число байтов, которое PutVarint записывает для значения
+std::size_t GetVarintSize(std::uint64_t value);
+void PutSignedVarint(std::string& output, std::int64_t value);
+void PutFixed32(std::string& output, std::uint32_t value);
+void PutFixed64(std::string& output, std::uint64_t value);
+void PutDouble(std::string& output, double value);
+void PutString(std::string& output, std::string_view value);
+
+// CRC-32 (IEEE 802.3)
+std::uint32_t ComputeCrc32(std::string_view data);
+
+// Методы чтения бросают CorruptedDataError, если данные закончились раньше значения
+class BinaryReader {
+public:
+    explicit BinaryReader(std::string_view data);
+
+    std::uint64_t ReadVarint();
+    std::int64_t ReadSignedVarint();
+    std::uint32_t ReadFixed32();
+    std::uint64_t ReadFixed64();
+    double ReadDouble();
+    // Представление указывает в исходные данные
+    std::string_view ReadString();
+    std::string_view ReadBytes(std::size_t size);
+
+    bool empty() const;
+
+private:
+    std::string_view data_;
+};
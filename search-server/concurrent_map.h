@@ -1,58 +1,283 @@
-#include <cstdlib>
-#include <future>
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
-#include <mutex>
+
+#include "thread_pool.h"
 
 using namespace std::string_literals;
 
-template <typename Key, typename Value>
+// Хеш-таблица для заполнения из нескольких потоков. Ключи распределяются по сегментам
+// по старшим битам хеша; сегмент — таблица с открытой адресацией и линейным пробированием
+// под собственным мьютексом. Каждый сегмент занимает отдельные строки кэша,
+// так что потоки, работающие с разными сегментами, не мешают друг другу.
+// Ключи — любые типы с Hash и operator==.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
 class ConcurrentMap {
 private:
-    struct Bucket {
+    static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    struct Entry {
+        std::uint64_t hash;
+        Key key;
+        Value value;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Shard {
         std::mutex mutex;
-        std::map<Key, Value> map;
+        std::vector<std::optional<Entry>> slots;
+        std::size_t size = 0;
+
+        Value& FindOrInsert(const Key& key, std::uint64_t hash);
+        bool Erase(const Key& key, std::uint64_t hash);
+        std::size_t FindSlot(const Key& key, std::uint64_t hash) const;
+        void Grow();
     };
 
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys"s);
-
+    // Значение доступно, пока объект Access удерживает блокировку его сегмента
     struct Access {
         std::lock_guard<std::mutex> guard;
         Value& ref_to_value;
 
-        Access(const Key& key, Bucket& bucket)
-            : guard(bucket.mutex)
-            , ref_to_value(bucket.map[key]) {
+        Access(const Key& key, std::uint64_t hash, Shard& shard)
+            : guard(shard.mutex)
+            , ref_to_value(shard.FindOrInsert(key, hash)) {
         }
     };
 
-    explicit ConcurrentMap(size_t bucket_count)
-        : buckets_(bucket_count) {
+    // Число сегментов округляется вверх до степени двойки
+    explicit ConcurrentMap(std::size_t bucket_count);
+
+    Access operator[](const Key& key);
+
+    // Прибавляет delta к значению ключа (отсутствующий ключ получает Value{}) и возвращает прежнее значение
+    template <typename Delta>
+    Value FetchAdd(const Key& key, Delta delta);
+
+    std::optional<Value> Find(const Key& key) const;
+
+    void erase(const Key& key);
+
+    std::size_t size() const;
+
+    // Обходит элементы, блокируя сегменты по одному, без копирования таблицы.
+    // Изменения других сегментов во время обхода не блокируются; function не должна обращаться к этой таблице
+    template <typename Function>
+    void ForEach(Function function);
+
+    // Сегменты обходятся параллельно; function вызывается одновременно для элементов разных сегментов
+    template <typename Function>
+    void ForEach(ThreadPool& pool, Function function);
+
+    std::map<Key, Value> BuildOrdinaryMap();
+
+private:
+    static constexpr std::size_t MIN_SHARD_CAPACITY = 8;
+    static constexpr int SHARD_BITS_OFFSET = 40;
+
+    mutable std::vector<Shard> shards_;
+    Hash hasher_;
+
+    // Финализатор SplitMix64: у std::hash для целых хеш равен ключу, а сегмент и ячейка берутся из разных битов
+    std::uint64_t ComputeHash(const Key& key) const;
+
+    Shard& GetShard(std::uint64_t hash) const;
+
+    template <typename Function>
+    void VisitShard(Shard& shard, Function& function);
+};
+
+template <typename Key, typename Value, typename Hash>
+ConcurrentMap<Key, Value, Hash>::ConcurrentMap(std::size_t bucket_count) {
+    if (bucket_count == 0) {
+        throw std::invalid_argument("Bucket count must be positive"s);
+    }
+    if (bucket_count > (std::size_t{1} << (64 - SHARD_BITS_OFFSET))) {
+        throw std::invalid_argument("Bucket count is too large"s);
+    }
+    std::size_t shard_count = 1;
+    while (shard_count < bucket_count) {
+        shard_count *= 2;
+    }
+    // Сегменты создаются на месте: мьютекс не перемещается
+    shards_ = std::vector<Shard>(shard_count);
+}
+
+template <typename Key, typename Value, typename Hash>
+typename ConcurrentMap<Key, Value, Hash>::Access ConcurrentMap<Key, Value, Hash>::operator[](const Key& key) {
+    const std::uint64_t hash = ComputeHash(key);
+    return {key, hash, GetShard(hash)};
+}
+
+template <typename Key, typename Value, typename Hash>
+template <typename Delta>
+Value ConcurrentMap<Key, Value, Hash>::FetchAdd(const Key& key, Delta delta) {
+    static_assert(std::is_arithmetic_v<Value>, "FetchAdd requires an arithmetic value type");
+
+    const std::uint64_t hash = ComputeHash(key);
+    Shard& shard = GetShard(hash);
+    std::lock_guard guard(shard.mutex);
+    Value& value = shard.FindOrInsert(key, hash);
+    const Value previous = value;
+    value += delta;
+    return previous;
+}
+
+template <typename Key, typename Value, typename Hash>
+std::optional<Value> ConcurrentMap<Key, Value, Hash>::Find(const Key& key) const {
+    const std::uint64_t hash = ComputeHash(key);
+    Shard& shard = GetShard(hash);
+    std::lock_guard guard(shard.mutex);
+    if (shard.size == 0) {
+        return std::nullopt;
+    }
+    const auto& slot = shard.slots[shard.FindSlot(key, hash)];
+    if (!slot) {
+        return std::nullopt;
     }
+    return slot->value;
+}
 
-    Access operator[](const Key& key) {
-        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
-        return {key, bucket};
+template <typename Key, typename Value, typename Hash>
+void ConcurrentMap<Key, Value, Hash>::erase(const Key& key) {
+    const std::uint64_t hash = ComputeHash(key);
+    Shard& shard = GetShard(hash);
+    std::lock_guard guard(shard.mutex);
+    shard.Erase(key, hash);
+}
+
+template <typename Key, typename Value, typename Hash>
+std::size_t ConcurrentMap<Key, Value, Hash>::size() const {
+    std::size_t result = 0;
+    for (auto& shard : shards_) {
+        std::lock_guard guard(shard.mutex);
+        result += shard.size;
     }
+    return result;
+}
 
-    void erase(const Key& key) {
-        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
-        std::lock_guard guard(bucket.mutex);
-        bucket.map.erase(key);
+template <typename Key, typename Value, typename Hash>
+template <typename Function>
+void ConcurrentMap<Key, Value, Hash>::ForEach(Function function) {
+    for (auto& shard : shards_) {
+        VisitShard(shard, function);
     }
+}
+
+template <typename Key, typename Value, typename Hash>
+template <typename Function>
+void ConcurrentMap<Key, Value, Hash>::ForEach(ThreadPool& pool, Function function) {
+    pool.ParallelFor(0, shards_.size(), [this, &function](std::size_t index) {
+        VisitShard(shards_[index], function);
+    });
+}
+
+template <typename Key, typename Value, typename Hash>
+std::map<Key, Value> ConcurrentMap<Key, Value, Hash>::BuildOrdinaryMap() {
+    std::map<Key, Value> result;
+    ForEach([&result](const Key& key, const Value& value) {
+        result.emplace(key, value);
+    });
+    return result;
+}
 
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result;
-        for (auto& [mutex, map] : buckets_) {
-            std::lock_guard g(mutex);
-            result.insert(map.begin(), map.end());
+template <typename Key, typename Value, typename Hash>
+std::uint64_t ConcurrentMap<Key, Value, Hash>::ComputeHash(const Key& key) const {
+    std::uint64_t hash = static_cast<std::uint64_t>(hasher_(key));
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+template <typename Key, typename Value, typename Hash>
+typename ConcurrentMap<Key, Value, Hash>::Shard& ConcurrentMap<Key, Value, Hash>::GetShard(std::uint64_t hash) const {
+    return shards_[(hash >> SHARD_BITS_OFFSET) & (shards_.size() - 1)];
+}
+
+template <typename Key, typename Value, typename Hash>
+template <typename Function>
+void ConcurrentMap<Key, Value, Hash>::VisitShard(Shard& shard, Function& function) {
+    std::lock_guard guard(shard.mutex);
+    for (auto& slot : shard.slots) {
+        if (slot) {
+            function(std::as_const(slot->key), slot->value);
         }
-        return result;
     }
+}
 
-private:
-    std::vector<Bucket> buckets_;
-};
+template <typename Key, typename Value, typename Hash>
+Value& ConcurrentMap<Key, Value, Hash>::Shard::FindOrInsert(const Key& key, std::uint64_t hash) {
+    // Заполненность не больше 3/4, чтобы цепочки пробирования оставались короткими
+    if ((size + 1) * 4 > slots.size() * 3) {
+        Grow();
+    }
+    auto& slot = slots[FindSlot(key, hash)];
+    if (!slot) {
+        slot.emplace(Entry{hash, key, Value{}});
+        ++size;
+    }
+    return slot->value;
+}
 
+template <typename Key, typename Value, typename Hash>
+bool ConcurrentMap<Key, Value, Hash>::Shard::Erase(const Key& key, std::uint64_t hash) {
+    if (size == 0) {
+        return false;
+    }
+    std::size_t hole = FindSlot(key, hash);
+    if (!slots[hole]) {
+        return false;
+    }
+    slots[hole].reset();
+    --size;
+
+    // Сдвиг следующих элементов цепочки на место удалённого вместо меток удаления
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t index = (hole + 1) & mask; slots[index]; index = (index + 1) & mask) {
+        const std::size_t home = slots[index]->hash & mask;
+        // Элемент можно перенести, если освободившаяся ячейка лежит между его исходной ячейкой и текущей
+        if (((index - home) & mask) >= ((index - hole) & mask)) {
+            slots[hole] = std::move(slots[index]);
+            slots[index].reset();
+            hole = index;
+        }
+    }
+    return true;
+}
+
+template <typename Key, typename Value, typename Hash>
+std::size_t ConcurrentMap<Key, Value, Hash>::Shard::FindSlot(const Key& key, std::uint64_t hash) const {
+    const std::size_t mask = slots.size() - 1;
+    std::size_t index = hash & mask;
+    while (slots[index] && !(slots[index]->hash == hash && slots[index]->key == key)) {
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+template <typename Key, typename Value, typename Hash>
+void ConcurrentMap<Key, Value, Hash>::Shard::Grow() {
+    std::vector<std::optional<Entry>> old_slots(std::max(slots.size() * 2, MIN_SHARD_CAPACITY));
+    old_slots.swap(slots);
+    const std::size_t mask = slots.size() - 1;
+    for (auto& slot : old_slots) {
+        if (slot) {
+            std::size_t index = slot->hash & mask;
+            while (slots[index]) {
+                index = (index + 1) & mask;
+            }
+            slots[index] = std::move(slot);
+        }
+    }
+}
@@ -0,0 +1,189 @@
+#include "corpus_loader.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <deque>
+#include <exception>
+#include <future>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const array<string_view, DOCUMENT_STATUS_COUNT> STATUS_NAMES = {"ACTUAL"sv, "IRRELEVANT"sv, "BANNED"sv, "REMOVED"sv};
+
+string_view NextField(string_view& line) {
+    const size_t tab = line.find('\t');
+    if (tab == line.npos) {
+        throw invalid_argument("Missing tab-separated field"s);
+    }
+    const string_view field = line.substr(0, tab);
+    line.remove_prefix(tab + 1);
+    return field;
+}
+
+int ParseInt(string_view text) {
+    int value = 0;
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc{} || end != text.data() + text.size()) {
+        throw invalid_argument("Invalid number \""s + string(text) + "\""s);
+    }
+    return value;
+}
+
+DocumentStatus ParseStatus(string_view text) {
+    const auto it = find(STATUS_NAMES.begin(), STATUS_NAMES.end(), text);
+    if (it != STATUS_NAMES.end()) {
+        return static_cast<DocumentStatus>(it - STATUS_NAMES.begin());
+    }
+    const int status = ParseInt(text);
+    if (status < 0 || static_cast<size_t>(status) >= DOCUMENT_STATUS_COUNT) {
+        throw invalid_argument("Invalid status \""s + string(text) + "\""s);
+    }
+    return static_cast<DocumentStatus>(status);
+}
+
+CorpusDocument ParseLine(string_view line) {
+    CorpusDocument document;
+    document.id = ParseInt(NextField(line));
+    document.status = ParseStatus(NextField(line));
+    const string_view ratings = NextField(line);
+    for (size_t begin = 0; begin < ratings.size();) {
+        const size_t end = min(ratings.find(',', begin), ratings.size());
+        document.ratings.push_back(ParseInt(ratings.substr(begin, end - begin)));
+        begin = end + 1;
+    }
+    document.text = line;
+    return document;
+}
+
+// Документы до первой ошибочной строки и ошибка с её номером
+struct ParsedChunk {
+    vector<CorpusDocument> documents;
+    exception_ptr error;
+};
+
+ParsedChunk ParseChunk(string_view data, size_t begin, size_t end) {
+    ParsedChunk chunk;
+    for (size_t line_begin = begin; line_begin < end;) {
+        const size_t line_end = min(data.find('\n', line_begin), end);
+        string_view line = data.substr(line_begin, line_end - line_begin);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            try {
+                chunk.documents.push_back(ParseLine(line));
+            } catch (const invalid_argument& e) {
+                // Номер строки нужен только для сообщения, поэтому считается лишь при ошибке
+                const auto line_number = count(data.begin(), data.begin() + line_begin, '\n') + 1;
+                chunk.error = make_exception_ptr(invalid_argument("Corpus line "s + to_string(line_number) + ": "s + e.what()));
+                break;
+            }
+        }
+        line_begin = line_end + 1;
+    }
+    return chunk;
+}
+
+} // namespace
+
+MappedFile::MappedFile(const filesystem::path& path) {
+    const int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        throw system_error(errno, generic_category(), "Failed to open "s + path.string());
+    }
+    struct stat file_stat;
+    if (::fstat(file, &file_stat) != 0) {
+        const int error = errno;
+        ::close(file);
+        throw system_error(error, generic_category(), "Failed to stat "s + path.string());
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    const int error = errno;
+    ::close(file);
+    if (data_ == MAP_FAILED) {
+        data_ = nullptr;
+        throw system_error(error, generic_category(), "Failed to map "s + path.string());
+    }
+    if (data_) {
+        // Файл читается один раз подряд: ядро может читать вперёд и сразу освобождать прочитанное
+        ::madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        ::munmap(data_, size_);
+    }
+}
+
+string_view MappedFile::GetData() const {
+    return {static_cast<const char*>(data_), size_};
+}
+
+size_t LoadCorpus(const filesystem::path& path, const function<void(const CorpusDocument&)>& consume,
+                  ThreadPool& pool, const CorpusLoadOptions& options) {
+    const MappedFile file(path);
+    const string_view data = file.GetData();
+    const size_t chunk_size = max<size_t>(options.chunk_size, 1);
+    const size_t chunks_in_flight = max<size_t>(options.chunks_in_flight, 1);
+
+    // Части разбираются впереди, но передаются обработчику строго по порядку.
+    // Задачи читают отображение, поэтому при исключении их нужно дождаться до закрытия файла
+    struct PendingChunks {
+        deque<future<ParsedChunk>> futures;
+
+        ~PendingChunks() {
+            for (auto& chunk : futures) {
+                chunk.wait();
+            }
+        }
+    } pending;
+    auto& chunks = pending.futures;
+    size_t next_begin = 0;
+    const auto submit_chunk = [&] {
+        const size_t boundary = min(next_begin + chunk_size, data.size());
+        const size_t newline = data.find('\n', boundary == 0 ? 0 : boundary - 1);
+        const size_t end = newline == data.npos ? data.size() : newline + 1;
+        chunks.push_back(pool.Submit([data, begin = next_begin, end] {
+            return ParseChunk(data, begin, end);
+        }));
+        next_begin = end;
+    };
+
+    size_t document_count = 0;
+    while (next_begin < data.size() || !chunks.empty()) {
+        while (next_begin < data.size() && chunks.size() < chunks_in_flight) {
+            submit_chunk();
+        }
+        const ParsedChunk chunk = chunks.front().get();
+        chunks.pop_front();
+        for (const auto& document : chunk.documents) {
+            consume(document);
+            ++document_count;
+        }
+        if (chunk.error) {
+            rethrow_exception(chunk.error);
+        }
+    }
+    return document_count;
+}
+
+size_t LoadCorpus(const filesystem::path& path, SearchServer& search_server, const CorpusLoadOptions& options) {
+    return LoadCorpus(path, [&search_server](const CorpusDocument& document) {
+        search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+    }, ThreadPool::GetDefault(), options);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "search_server.h"
+#include "thread_pool.h"
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    std::string_view GetData() const;
+
+private:
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Текст указывает в отображённый файл и действителен только во время вызова обработчика
+struct CorpusDocument {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+struct CorpusLoadOptions {
+    // Примерный размер части файла, которую разбирает одна задача; части заканчиваются на границе строки
+    std::size_t chunk_size = 4 << 20;
+    // Сколько частей разбирается впереди передачи документов обработчику
+    std::size_t chunks_in_flight = 16;
+};
+
+// Загружает корпус, по документу на строку: id, статус, оценки через запятую и текст,
+// разделённые табуляцией, например "17\tACTUAL\t5,-1,3\tfunny pet". Статус — имя или номер
+// DocumentStatus, список оценок может быть пустым, пустые строки пропускаются.
+//
+// Файл отображается в память и режется на части, которые разбираются параллельно в пуле;
+// обработчик получает документы в порядке файла в вызывающем потоке, без копирования текста.
+// Ошибка разбора — std::invalid_argument с номером строки, документы до неё уже переданы.
+// Возвращает число документов.
+std::size_t LoadCorpus(const std::filesystem::path& path, const std::function<void(const CorpusDocument&)>& consume,
+                       ThreadPool& pool, const CorpusLoadOptions& options = {});
+
+std::size_t LoadCorpus(const std::filesystem::path& path, SearchServer& search_server, const CorpusLoadOptions& options = {});
@@ -0,0 +1,58 @@
+#include "document_bitmap.h"
+
+#include <algorithm>
+
+using namespace std;
+
+void DocumentBitmap::Set(uint32_t index) {
+    const size_t word = index / WORD_BITS;
+    if (word >= words_.size()) {
+        words_.resize(word + 1);
+    }
+    words_[word] |= Word{1} << (index % WORD_BITS);
+}
+
+void DocumentBitmap::Reset(uint32_t index) {
+    const size_t word = index / WORD_BITS;
+    if (word < words_.size()) {
+        words_[word] &= ~(Word{1} << (index % WORD_BITS));
+    }
+}
+
+size_t DocumentBitmap::Count() const {
+    size_t count = 0;
+    for (const Word bits : words_) {
+        count += CountOnes(bits);
+    }
+    return count;
+}
+
+bool DocumentBitmap::None() const {
+    return all_of(words_.begin(), words_.end(), [](Word bits) {
+        return bits == 0;
+    });
+}
+
+DocumentBitmap& DocumentBitmap::operator&=(const DocumentBitmap& other) {
+    if (words_.size() > other.words_.size()) {
+        words_.resize(other.words_.size());
+    }
+    for (size_t word = 0; word < words_.size(); ++word) {
+        words_[word] &= other.words_[word];
+    }
+    return *this;
+}
+
+DocumentBitmap& DocumentBitmap::operator|=(const DocumentBitmap& other) {
+    if (words_.size() < other.words_.size()) {
+        words_.resize(other.words_.size());
+    }
+    for (size_t word = 0; word < other.words_.size(); ++word) {
+        words_[word] |= other.words_[word];
+    }
+    return *this;
+}
+
+MemoryUsage DocumentBitmap::GetMemoryUsage() const {
+    return words_.get_allocator().GetUsage();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "memory_accounting.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+inline int CountTrailingZeros(std::uint64_t bits) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+inline int CountOnes(std::uint64_t bits) {
+#if defined(_MSC_VER)
+    return static_cast<int>(__popcnt64(bits));
+#else
+    return __builtin_popcountll(bits);
+#endif
+}
+
+// Множество внутренних идентификаторов документов в виде битовой карты
+class DocumentBitmap {
+public:
+    using Word = std::uint64_t;
+
+    static constexpr std::size_t WORD_BITS = 64;
+
+    void Set(std::uint32_t index);
+    void Reset(std::uint32_t index);
+
+    bool Test(std::uint32_t index) const {
+        const std::size_t word = index / WORD_BITS;
+        return word < words_.size() && (words_[word] >> (index % WORD_BITS) & 1);
+    }
+
+    std::size_t Count() const;
+    bool None() const;
+
+    DocumentBitmap& operator&=(const DocumentBitmap& other);
+    DocumentBitmap& operator|=(const DocumentBitmap& other);
+
+    template <typename Function>
+    void ForEach(Function function) const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    std::vector<Word, CountingAllocator<Word>> words_;
+};
+
+template <typename Function>
+void DocumentBitmap::ForEach(Function function) const {
+    for (std::size_t word = 0; word < words_.size(); ++word) {
+        for (Word bits = words_[word]; bits != 0; bits &= bits - 1) {
+            function(static_cast<std::uint32_t>(word * WORD_BITS + CountTrailingZeros(bits)));
+        }
+    }
+}
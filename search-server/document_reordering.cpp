@@ -0,0 +1,133 @@
+#include "document_reordering.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace std;
+
+namespace {
+
+// Части не меньше этого размера делятся дальше параллельно
+const size_t PARALLEL_PARTITION_SIZE = 4096;
+
+// Оценка размера списка слова в половине из size документов, degree из которых содержат слово
+double ComputeCost(size_t degree, size_t size) {
+    return degree * log2(size / (degree + 1.0));
+}
+
+void Bisect(const vector<vector<TermId>>& documents, uint32_t* begin, uint32_t* end, ThreadPool& pool, const DocumentReorderingOptions& options) {
+    const size_t size = end - begin;
+    if (size <= max<size_t>(options.min_partition_size, 1)) {
+        return;
+    }
+    const size_t half = size / 2;
+
+    // Слова части получают плотные локальные номера, чтобы счётчики не зависели от размера словаря
+    vector<TermId> terms;
+    for (const uint32_t* document = begin; document != end; ++document) {
+        terms.insert(terms.end(), documents[*document].begin(), documents[*document].end());
+    }
+    sort(terms.begin(), terms.end());
+    terms.erase(unique(terms.begin(), terms.end()), terms.end());
+
+    vector<size_t> offsets(size + 1);
+    vector<uint32_t> local_terms;
+    for (size_t i = 0; i < size; ++i) {
+        for (const TermId term : documents[begin[i]]) {
+            local_terms.push_back(static_cast<uint32_t>(lower_bound(terms.begin(), terms.end(), term) - terms.begin()));
+        }
+        offsets[i + 1] = local_terms.size();
+    }
+
+    // order[0, half) — левая половина, order[half, size) — правая; элементы — позиции в [begin, end)
+    vector<uint32_t> order(size);
+    iota(order.begin(), order.end(), 0);
+    vector<uint32_t> left_degrees(terms.size());
+    vector<uint32_t> right_degrees(terms.size());
+    vector<double> left_to_right_gains(terms.size());
+    vector<double> right_to_left_gains(terms.size());
+    vector<double> gains(size);
+    const size_t left_size = half;
+    const size_t right_size = size - half;
+
+    for (size_t iteration = 0; iteration < options.max_iterations; ++iteration) {
+        fill(left_degrees.begin(), left_degrees.end(), 0);
+        fill(right_degrees.begin(), right_degrees.end(), 0);
+        for (size_t i = 0; i < size; ++i) {
+            auto& degrees = i < half ? left_degrees : right_degrees;
+            for (size_t j = offsets[order[i]]; j < offsets[order[i] + 1]; ++j) {
+                ++degrees[local_terms[j]];
+            }
+        }
+        for (size_t term = 0; term < terms.size(); ++term) {
+            const size_t left = left_degrees[term];
+            const size_t right = right_degrees[term];
+            const double cost = ComputeCost(left, left_size) + ComputeCost(right, right_size);
+            left_to_right_gains[term] = left > 0 ? cost - ComputeCost(left - 1, left_size) - ComputeCost(right + 1, right_size) : 0.0;
+            right_to_left_gains[term] = right > 0 ? cost - ComputeCost(left + 1, left_size) - ComputeCost(right - 1, right_size) : 0.0;
+        }
+        for (size_t i = 0; i < size; ++i) {
+            const auto& term_gains = i < half ? left_to_right_gains : right_to_left_gains;
+            double gain = 0.0;
+            for (size_t j = offsets[order[i]]; j < offsets[order[i] + 1]; ++j) {
+                gain += term_gains[local_terms[j]];
+            }
+            gains[order[i]] = gain;
+        }
+
+        // Документы, которым выгоднее всего перейти, меняются местами попарно, пока обмен уменьшает оценку
+        const auto by_gain = [&gains](uint32_t lhs, uint32_t rhs) {
+            return gains[lhs] > gains[rhs];
+        };
+        sort(order.begin(), order.begin() + half, by_gain);
+        sort(order.begin() + half, order.end(), by_gain);
+        size_t swap_count = 0;
+        for (; swap_count < half && gains[order[swap_count]] + gains[order[half + swap_count]] > 0.0; ++swap_count) {
+            swap(order[swap_count], order[half + swap_count]);
+        }
+        if (swap_count == 0) {
+            break;
+        }
+    }
+
+    vector<uint32_t> reordered(size);
+    for (size_t i = 0; i < size; ++i) {
+        reordered[i] = begin[order[i]];
+    }
+    copy(reordered.begin(), reordered.end(), begin);
+
+    if (size >= PARALLEL_PARTITION_SIZE) {
+        pool.ParallelFor(0, 2, [&documents, begin, end, half, &pool, &options](size_t part) {
+            if (part == 0) {
+                Bisect(documents, begin, begin + half, pool, options);
+            } else {
+                Bisect(documents, begin + half, end, pool, options);
+            }
+        });
+    } else {
+        Bisect(documents, begin, begin + half, pool, options);
+        Bisect(documents, begin + half, end, pool, options);
+    }
+}
+
+double ComputeCompressionRatio(size_t posting_count, size_t encoded_size) {
+    return encoded_size > 0 ? posting_count * sizeof(uint32_t) * 1.0 / encoded_size : 1.0;
+}
+
+} // namespace
+
+vector<uint32_t> ComputeBisectionOrder(const vector<vector<TermId>>& documents, ThreadPool& pool, const DocumentReorderingOptions& options) {
+    vector<uint32_t> order(documents.size());
+    iota(order.begin(), order.end(), 0);
+    Bisect(documents, order.data(), order.data() + order.size(), pool, options);
+    return order;
+}
+
+double DocumentReorderingReport::GetCompressionRatioBefore() const {
+    return ComputeCompressionRatio(posting_count, encoded_size_before);
+}
+
+double DocumentReorderingReport::GetCompressionRatioAfter() const {
+    return ComputeCompressionRatio(posting_count, encoded_size_after);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "binary_encoding.h"
+#include "term_dictionary.h"
+#include "thread_pool.h"
+
+struct DocumentReorderingOptions {
+    // Части меньше этого размера не делятся дальше
+    std::size_t min_partition_size = 16;
+    // Число проходов обмена документами между половинами на каждом уровне
+    std::size_t max_iterations = 20;
+};
+
+// Порядок документов по рекурсивной бисекции графа документов и слов (BP, Dhulipala и др., 2016).
+// Документы делятся пополам, затем половины обмениваются документами, пока это уменьшает
+// оценку размера списков документов — сумму по словам d·log(n / (d + 1)) для каждой половины,
+// где d — число документов половины со словом, n — размер половины. Обе половины делятся так же.
+// documents[i] — слова i-го документа. Возвращает номера документов в новом порядке.
+std::vector<std::uint32_t> ComputeBisectionOrder(const std::vector<std::vector<TermId>>& documents, ThreadPool& pool,
+                                                 const DocumentReorderingOptions& options = {});
+
+// Размеры списков документов при кодировании разностей соседних идентификаторов varint-ом
+struct DocumentReorderingReport {
+    std::size_t document_count = 0;
+    std::size_t posting_count = 0;
+    std::size_t encoded_size_before = 0;
+    std::size_t encoded_size_after = 0;
+
+    // Отношение размера идентификаторов без сжатия (4 байта) к размеру разностей
+    double GetCompressionRatioBefore() const;
+    double GetCompressionRatioAfter() const;
+};
+
+// Размер списка, отсортированного по идентификатору документа; у записей есть поле document
+template <typename Postings>
+std::size_t ComputeEncodedGapSize(const Postings& postings) {
+    std::size_t size = 0;
+    std::uint64_t previous = 0;
+    for (const auto& posting : postings) {
+        size += GetVarintSize(posting.document - previous);
+        previous = posting.document;
+    }
+    return size;
+}
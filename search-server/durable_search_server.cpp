@@ -0,0 +1,284 @@
+#include "durable_search_server.h"
+
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "binary_encoding.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+const uint32_t CHECKPOINT_MAGIC = 0x50435353; // "SSCP"
+const char CHECKPOINT_NAME[] = "checkpoint";
+const char CHECKPOINT_TEMP_NAME[] = "checkpoint.tmp";
+
+enum class RecordType : uint8_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT = 2,
+    UPDATE_DOCUMENT = 3,
+    UPDATE_METADATA = 4,
+};
+
+// Тип, идентификатор, статус и оценки; текст документа дописывается отдельно
+string MakeDocumentRecord(RecordType type, int document_id, DocumentStatus status, const vector<int>& ratings) {
+    string record;
+    record.push_back(static_cast<char>(type));
+    PutSignedVarint(record, document_id);
+    PutVarint(record, static_cast<uint64_t>(status));
+    PutVarint(record, ratings.size());
+    for (const int rating : ratings) {
+        PutSignedVarint(record, rating);
+    }
+    return record;
+}
+
+// Целое, записанное PutSignedVarint; значение вне диапазона int — признак повреждения, а не повод его усечь
+int ReadInt(BinaryReader& reader) {
+    const int64_t value = reader.ReadSignedVarint();
+    if (value < numeric_limits<int>::min() || value > numeric_limits<int>::max()) {
+        throw CorruptedDataError("Log record value "s + to_string(value) + " is out of int range"s);
+    }
+    return static_cast<int>(value);
+}
+
+void WriteFileDurably(const fs::path& path, string_view data) {
+    const int file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file < 0) {
+        throw system_error(errno, generic_category(), "Failed to create "s + path.string());
+    }
+    while (!data.empty()) {
+        const ssize_t written = ::write(file, data.data(), data.size());
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            const int error = errno;
+            ::close(file);
+            throw system_error(error, generic_category(), "Failed to write "s + path.string());
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+    const int result = ::fsync(file);
+    const int error = errno;
+    ::close(file);
+    if (result != 0) {
+        throw system_error(error, generic_category(), "Failed to sync "s + path.string());
+    }
+}
+
+} // namespace
+
+DurableSearchServer::DurableSearchServer(const fs::path& directory, string_view stop_words_text, Options options)
+    : DurableSearchServer(directory, options, Recover(directory, stop_words_text)) {
+}
+
+DurableSearchServer::DurableSearchServer(const fs::path& directory, string_view stop_words_text)
+    : DurableSearchServer(directory, stop_words_text, Options{}) {
+}
+
+DurableSearchServer::DurableSearchServer(const fs::path& directory, Options options, RecoveredIndex index)
+    : directory_(directory)
+    , options_(options)
+    , server_(move(index.server))
+    , log_(directory, index.last_lsn + 1, {options.group_commit_delay}) {
+    if (index.has_checkpoint) {
+        checkpoint_lsn_ = index.checkpoint_lsn;
+    }
+    // Стоп-слова нового индекса должны пережить сбой раньше первой записи журнала.
+    // Журнал уже открыл новый сегмент, так что все прежние записи входят в эту контрольную точку
+    if (!index.has_checkpoint || index.last_lsn > index.checkpoint_lsn) {
+        lock_guard lock(checkpoint_mutex_);
+        WriteCheckpoint(index.last_lsn, server_);
+    }
+}
+
+void DurableSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    string record = MakeDocumentRecord(RecordType::ADD_DOCUMENT, document_id, status, ratings);
+    PutString(record, document);
+    Commit(record, [&](const SearchServer& server) {
+        server.CheckAddDocument(document_id, document);
+    }, [&](SearchServer& server) {
+        server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void DurableSearchServer::UpdateDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    string record = MakeDocumentRecord(RecordType::UPDATE_DOCUMENT, document_id, status, ratings);
+    PutString(record, document);
+    Commit(record, [&](const SearchServer& server) {
+        server.CheckUpdateDocument(document_id, document);
+    }, [&](SearchServer& server) {
+        server.UpdateDocument(document_id, document, status, ratings);
+    });
+}
+
+void DurableSearchServer::UpdateDocument(int document_id, DocumentStatus status, const vector<int>& ratings) {
+    Commit(MakeDocumentRecord(RecordType::UPDATE_METADATA, document_id, status, ratings), [&](const SearchServer& server) {
+        server.CheckUpdateDocument(document_id);
+    }, [&](SearchServer& server) {
+        server.UpdateDocument(document_id, status, ratings);
+    });
+}
+
+void DurableSearchServer::RemoveDocument(int document_id) {
+    string record;
+    record.push_back(static_cast<char>(RecordType::REMOVE_DOCUMENT));
+    PutSignedVarint(record, document_id);
+    // Удаление отсутствующего документа ничего не делает, проверять нечего
+    Commit(record, [](const SearchServer&) {
+    }, [document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+    });
+}
+
+void DurableSearchServer::Sync() {
+    log_.Sync();
+}
+
+void DurableSearchServer::Checkpoint() {
+    uint64_t lsn;
+    {
+        lock_guard lock(write_mutex_);
+        // Записи нового сегмента новее контрольной точки, старые сегменты после неё не нужны
+        lsn = log_.StartSegment() - 1;
+    }
+    BuildCheckpoint(lsn);
+}
+
+const SearchServer& DurableSearchServer::GetServer() const {
+    return server_;
+}
+
+uint64_t DurableSearchServer::GetLastLsn() const {
+    return log_.GetLastLsn();
+}
+
+DurableSearchServer::RecoveredIndex DurableSearchServer::Recover(const fs::path& directory, string_view stop_words_text) {
+    fs::create_directories(directory);
+
+    auto checkpoint = LoadCheckpoint(directory);
+    RecoveredIndex index = checkpoint ? RecoveredIndex{move(checkpoint->first), checkpoint->second, checkpoint->second, true}
+                                      : RecoveredIndex{SearchServer(stop_words_text), 0, 0, false};
+    index.last_lsn = WriteAheadLog::Recover(directory, index.checkpoint_lsn, [&index](uint64_t, string_view record) {
+        ApplyRecord(index.server, record);
+    });
+    return index;
+}
+
+optional<pair<SearchServer, uint64_t>> DurableSearchServer::LoadCheckpoint(const fs::path& directory) {
+    const fs::path checkpoint_path = directory / CHECKPOINT_NAME;
+    if (!fs::exists(checkpoint_path)) {
+        return nullopt;
+    }
+
+    ifstream input(checkpoint_path, ios::binary);
+    const string data{istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+    BinaryReader reader(data);
+    if (reader.ReadFixed32() != CHECKPOINT_MAGIC) {
+        throw CorruptedDataError("Not a search index checkpoint: "s + checkpoint_path.string());
+    }
+    const uint64_t checkpoint_lsn = reader.ReadFixed64();
+    const uint32_t crc = reader.ReadFixed32();
+    const string_view index_data = string_view(data).substr(16);
+    if (ComputeCrc32(index_data) != crc) {
+        throw CorruptedDataError("Checkpoint checksum mismatch: "s + checkpoint_path.string());
+    }
+
+    return pair{SearchServer::Deserialize(index_data), checkpoint_lsn};
+}
+
+void DurableSearchServer::ApplyRecord(SearchServer& server, string_view record) {
+    BinaryReader reader(record);
+    const auto type = static_cast<RecordType>(reader.ReadBytes(1).front());
+    const int document_id = ReadInt(reader);
+    switch (type) {
+        case RecordType::ADD_DOCUMENT:
+        case RecordType::UPDATE_DOCUMENT:
+        case RecordType::UPDATE_METADATA: {
+            const uint64_t status = reader.ReadVarint();
+            const uint64_t rating_count = reader.ReadVarint();
+            if (status >= DOCUMENT_STATUS_COUNT || rating_count > record.size()) {
+                throw CorruptedDataError("Invalid document record"s);
+            }
+            vector<int> ratings(rating_count);
+            for (int& rating : ratings) {
+                rating = ReadInt(reader);
+            }
+            if (type == RecordType::UPDATE_METADATA) {
+                server.UpdateDocument(document_id, static_cast<DocumentStatus>(status), ratings);
+                break;
+            }
+            const string_view document = reader.ReadString();
+            if (type == RecordType::ADD_DOCUMENT) {
+                server.AddDocument(document_id, document, static_cast<DocumentStatus>(status), ratings);
+            } else {
+                server.UpdateDocument(document_id, document, static_cast<DocumentStatus>(status), ratings);
+            }
+            break;
+        }
+        case RecordType::REMOVE_DOCUMENT:
+            server.RemoveDocument(document_id);
+            break;
+        default:
+            throw CorruptedDataError("Unknown log record type"s);
+    }
+}
+
+void DurableSearchServer::ScheduleCheckpoint() {
+    // Пока строится предыдущая контрольная точка, сегмент просто растёт дальше
+    if (background_checkpoint_.valid() && background_checkpoint_.wait_for(chrono::seconds(0)) != future_status::ready) {
+        return;
+    }
+    const uint64_t lsn = log_.StartSegment() - 1;
+    // Ошибка прежней фоновой записи отбрасывается вместе с её future: новая контрольная точка её заменяет
+    background_checkpoint_ = async(launch::async, [this, lsn] {
+        BuildCheckpoint(lsn);
+    });
+}
+
+void DurableSearchServer::BuildCheckpoint(uint64_t lsn) {
+    // Старые сегменты читаются с диска, поэтому их записи должны быть там целиком,
+    // а новый сегмент — уже открыт, чтобы старые можно было удалить
+    log_.WaitSegment(lsn + 1);
+
+    lock_guard lock(checkpoint_mutex_);
+    if (checkpoint_lsn_ && lsn <= *checkpoint_lsn_) {
+        return;
+    }
+    // Индекс, а не его копия под блокировкой: те же записи журнала в том же порядке дают тот же индекс
+    auto checkpoint = LoadCheckpoint(directory_);
+    if (!checkpoint) {
+        throw CorruptedDataError("Checkpoint is missing in "s + directory_.string());
+    }
+    auto& [server, checkpoint_lsn] = *checkpoint;
+    WriteAheadLog::ReadRecords(directory_, checkpoint_lsn, lsn, [&server](uint64_t, string_view record) {
+        ApplyRecord(server, record);
+    });
+    WriteCheckpoint(lsn, server);
+}
+
+void DurableSearchServer::WriteCheckpoint(uint64_t lsn, const SearchServer& server) {
+    const string index_data = server.Serialize();
+    string data;
+    data.reserve(16 + index_data.size());
+    PutFixed32(data, CHECKPOINT_MAGIC);
+    PutFixed64(data, lsn);
+    PutFixed32(data, ComputeCrc32(index_data));
+    data.append(index_data);
+
+    WriteFileDurably(directory_ / CHECKPOINT_TEMP_NAME, data);
+    fs::rename(directory_ / CHECKPOINT_TEMP_NAME, directory_ / CHECKPOINT_NAME);
+    SyncDirectory(directory_);
+    checkpoint_lsn_ = lsn;
+    log_.RemoveSegmentsUpTo(lsn);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+// SearchServer, переживающий перезапуск: каждое изменение дописывается в журнал предзаписи,
+// а контрольная точка периодически сохраняет весь индекс. Восстановление загружает
+// последнюю контрольную точку и применяет только записи журнала после неё.
+//
+// Изменение сначала проверяется, затем попадает в журнал и только потом применяется к индексу,
+// поэтому ошибка записи журнала оставляет индекс прежним. Без sync_each_operation операция
+// подтверждается до fsync, и сбой может потерять последние group_commit_delay; Sync() дожидается
+// записи всех операций. Изменения и поиск по GetServer() синхронизируются так же, как для обычного SearchServer.
+class DurableSearchServer {
+public:
+    struct Options {
+        // Изменения возвращаются только после fsync своей записи;
+        // одновременные вызовы из нескольких потоков разделяют один fsync
+        bool sync_each_operation = false;
+        std::chrono::microseconds group_commit_delay{500};
+        // Контрольная точка записывается в фоне, когда сегмент журнала дорастает до этого размера; 0 — только явно.
+        // Под блокировкой изменений журнал только отмечает начало нового сегмента. Отдельный поток загружает
+        // предыдущую контрольную точку, применяет к ней записи старых сегментов и сохраняет результат,
+        // так что на это время в памяти вторая копия индекса. Неудачная фоновая запись ничего не теряет:
+        // старые сегменты остаются до следующей контрольной точки
+        std::size_t checkpoint_log_size = 64 << 20;
+    };
+
+    // Восстанавливает индекс из каталога или создаёт в нём новый индекс с этими стоп-словами
+    DurableSearchServer(const std::filesystem::path& directory, std::string_view stop_words_text, Options options);
+    DurableSearchServer(const std::filesystem::path& directory, std::string_view stop_words_text);
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void UpdateDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void UpdateDocument(int document_id, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    void Sync();
+    // Записывает контрольную точку в вызывающем потоке; изменения блокируются только на время переключения сегмента журнала
+    void Checkpoint();
+
+    const SearchServer& GetServer() const;
+
+    // Номер записи журнала последней операции
+    std::uint64_t GetLastLsn() const;
+
+private:
+    struct RecoveredIndex {
+        SearchServer server;
+        std::uint64_t checkpoint_lsn;
+        std::uint64_t last_lsn;
+        bool has_checkpoint;
+    };
+
+    const std::filesystem::path directory_;
+    const Options options_;
+    std::mutex write_mutex_;
+    SearchServer server_;
+    WriteAheadLog log_;
+
+    // Запись файлов контрольных точек; checkpoint_lsn_ — номер последней записанной
+    std::mutex checkpoint_mutex_;
+    std::optional<std::uint64_t> checkpoint_lsn_;
+    // Фоновая запись контрольной точки, доступ под write_mutex_. Объявлена последней,
+    // чтобы деструктор дождался её раньше, чем закроется журнал
+    std::future<void> background_checkpoint_;
+
+    DurableSearchServer(const std::filesystem::path& directory, Options options, RecoveredIndex index);
+
+    static RecoveredIndex Recover(const std::filesystem::path& directory, std::string_view stop_words_text);
+    // Индекс контрольной точки и номер последней вошедшей в неё записи; nullopt, если контрольной точки нет
+    static std::optional<std::pair<SearchServer, std::uint64_t>> LoadCheckpoint(const std::filesystem::path& directory);
+    static void ApplyRecord(SearchServer& server, std::string_view record);
+
+    // Проверяет изменение, записывает его в журнал и применяет к индексу
+    template <typename Check, typename Operation>
+    void Commit(const std::string& record, Check check, Operation operation);
+
+    // Вызывается под write_mutex_
+    void ScheduleCheckpoint();
+
+    // Строит контрольную точку на записи lsn из предыдущей и журнала, не блокируя изменений;
+    // не новее уже записанной пропускается
+    void BuildCheckpoint(std::uint64_t lsn);
+    // Вызывается под checkpoint_mutex_
+    void WriteCheckpoint(std::uint64_t lsn, const SearchServer& server);
+};
+
+template <typename Check, typename Operation>
+void DurableSearchServer::Commit(const std::string& record, Check check, Operation operation) {
+    std::uint64_t lsn;
+    {
+        std::lock_guard lock(write_mutex_);
+        check(std::as_const(server_));
+        lsn = log_.Append(record);
+        // Проверенное изменение бросает разве что bad_alloc; тогда восстановление повторит его по журналу
+        operation(server_);
+        if (options_.checkpoint_log_size > 0 && log_.GetSegmentSize() >= options_.checkpoint_log_size) {
+            ScheduleCheckpoint();
+        }
+    }
+    if (options_.sync_each_operation) {
+        log_.WaitDurable(lsn);
+    }
+}
@@ -0,0 +1,177 @@
+#include "forward_index.h"
+
+#include <algorithm>
+
+using namespace std;
+
+ForwardIndex::Row::Row(const TermId* terms, const double* freqs, size_t size)
+    : terms_(terms)
+    , freqs_(freqs)
+    , size_(size) {
+}
+
+size_t ForwardIndex::Row::size() const {
+    return size_;
+}
+
+bool ForwardIndex::Row::empty() const {
+    return size_ == 0;
+}
+
+TermId ForwardIndex::Row::GetTerm(size_t index) const {
+    return terms_[index];
+}
+
+double ForwardIndex::Row::GetFreq(size_t index) const {
+    return freqs_[index];
+}
+
+const TermId* ForwardIndex::Row::GetTerms() const {
+    return terms_;
+}
+
+const double* ForwardIndex::Row::GetFreqs() const {
+    return freqs_;
+}
+
+bool ForwardIndex::Row::Contains(TermId term) const {
+    return binary_search(terms_, terms_ + size_, term);
+}
+
+optional<double> ForwardIndex::Row::FindFreq(TermId term) const {
+    const TermId* it = lower_bound(terms_, terms_ + size_, term);
+    if (it == terms_ + size_ || *it != term) {
+        return nullopt;
+    }
+    return freqs_[it - terms_];
+}
+
+ForwardIndex::RowId ForwardIndex::AddRow(const vector<pair<TermId, double>>& entries) {
+    const RowId row = static_cast<RowId>(rows_.size());
+    rows_.push_back({terms_.size(), entries.size()});
+    for (const auto& [term, freq] : entries) {
+        terms_.push_back(term);
+        freqs_.push_back(freq);
+    }
+    return row;
+}
+
+void ForwardIndex::RemoveRow(RowId row) {
+    auto& range = rows_[row];
+    garbage_size_ += range.size;
+    range.size = 0;
+    if (garbage_size_ > terms_.size() - garbage_size_) {
+        Compact();
+    }
+}
+
+void ForwardIndex::ReplaceRow(RowId row, const vector<pair<TermId, double>>& entries) {
+    auto& range = rows_[row];
+    if (entries.size() <= range.size) {
+        garbage_size_ += range.size - entries.size();
+    } else {
+        garbage_size_ += range.size;
+        range.begin = terms_.size();
+        terms_.resize(terms_.size() + entries.size());
+        freqs_.resize(freqs_.size() + entries.size());
+    }
+    range.size = entries.size();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        terms_[range.begin + i] = entries[i].first;
+        freqs_[range.begin + i] = entries[i].second;
+    }
+    if (garbage_size_ > terms_.size() - garbage_size_) {
+        Compact();
+    }
+}
+
+ForwardIndex::Row ForwardIndex::GetRow(RowId row) const {
+    const auto& range = rows_[row];
+    return {terms_.data() + range.begin, freqs_.data() + range.begin, range.size};
+}
+
+MemoryUsage ForwardIndex::GetMemoryUsage() const {
+    MemoryUsage usage = rows_.get_allocator().GetUsage();
+    usage += terms_.get_allocator().GetUsage();
+    usage += freqs_.get_allocator().GetUsage();
+    return usage;
+}
+
+void ForwardIndex::Compact() {
+    // Строки, перенесённые ReplaceRow в конец, идут не по порядку, поэтому данные копируются в новые массивы
+    decltype(terms_) terms(terms_.get_allocator());
+    decltype(freqs_) freqs(freqs_.get_allocator());
+    terms.reserve(terms_.size() - garbage_size_);
+    freqs.reserve(freqs_.size() - garbage_size_);
+    for (auto& range : rows_) {
+        const size_t begin = terms.size();
+        terms.insert(terms.end(), terms_.begin() + range.begin, terms_.begin() + range.begin + range.size);
+        freqs.insert(freqs.end(), freqs_.begin() + range.begin, freqs_.begin() + range.begin + range.size);
+        range.begin = begin;
+    }
+    terms_ = move(terms);
+    freqs_ = move(freqs);
+    garbage_size_ = 0;
+}
+
+WordFrequencies::Iterator::Iterator(const TermId* term, const double* freq, const TermDictionary* terms)
+    : term_(term)
+    , freq_(freq)
+    , terms_(terms) {
+}
+
+WordFrequencies::Iterator::value_type WordFrequencies::Iterator::operator*() const {
+    return {terms_->GetWord(*term_), *freq_};
+}
+
+WordFrequencies::Iterator& WordFrequencies::Iterator::operator++() {
+    ++term_;
+    ++freq_;
+    return *this;
+}
+
+WordFrequencies::Iterator WordFrequencies::Iterator::operator++(int) {
+    Iterator result = *this;
+    ++*this;
+    return result;
+}
+
+bool WordFrequencies::Iterator::operator==(const Iterator& other) const {
+    return term_ == other.term_;
+}
+
+bool WordFrequencies::Iterator::operator!=(const Iterator& other) const {
+    return !(*this == other);
+}
+
+WordFrequencies::WordFrequencies(ForwardIndex::Row row, const TermDictionary& terms)
+    : row_(row)
+    , terms_(&terms) {
+}
+
+WordFrequencies::Iterator WordFrequencies::begin() const {
+    return {row_.GetTerms(), row_.GetFreqs(), terms_};
+}
+
+WordFrequencies::Iterator WordFrequencies::end() const {
+    return {row_.GetTerms() + row_.size(), row_.GetFreqs() + row_.size(), terms_};
+}
+
+size_t WordFrequencies::size() const {
+    return row_.size();
+}
+
+bool WordFrequencies::empty() const {
+    return row_.empty();
+}
+
+optional<double> WordFrequencies::Find(string_view word) const {
+    if (!terms_) {
+        return nullopt;
+    }
+    const auto term = terms_->Find(word);
+    if (!term) {
+        return nullopt;
+    }
+    return row_.FindFreq(*term);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "memory_accounting.h"
+#include "term_dictionary.h"
+
+// Прямой индекс в формате CSR: слова всех документов лежат подряд в общих массивах
+// идентификаторов слов и частот, внутри строки документа отсортированные по идентификатору.
+// Удалённые строки становятся пустыми, а их данные вычищаются при уплотнении,
+// когда мусора становится больше, чем живых данных.
+class ForwardIndex {
+public:
+    using RowId = std::uint32_t;
+
+    // Представление строки документа; действительно до следующего изменения индекса
+    class Row {
+    public:
+        Row() = default;
+        Row(const TermId* terms, const double* freqs, std::size_t size);
+
+        std::size_t size() const;
+        bool empty() const;
+
+        TermId GetTerm(std::size_t index) const;
+        double GetFreq(std::size_t index) const;
+
+        // Начала участков строки в общих массивах индекса
+        const TermId* GetTerms() const;
+        const double* GetFreqs() const;
+
+        bool Contains(TermId term) const;
+        std::optional<double> FindFreq(TermId term) const;
+
+    private:
+        const TermId* terms_ = nullptr;
+        const double* freqs_ = nullptr;
+        std::size_t size_ = 0;
+    };
+
+    // Пары должны быть отсортированы по идентификатору слова и не повторяться
+    RowId AddRow(const std::vector<std::pair<TermId, double>>& entries);
+    void RemoveRow(RowId row);
+    // Строка не длиннее прежней записывается на её место, более длинная — в конец массивов
+    void ReplaceRow(RowId row, const std::vector<std::pair<TermId, double>>& entries);
+
+    Row GetRow(RowId row) const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    struct RowRange {
+        std::size_t begin = 0;
+        std::size_t size = 0;
+    };
+
+    std::vector<RowRange, CountingAllocator<RowRange>> rows_;
+    std::vector<TermId, CountingAllocator<TermId>> terms_;
+    std::vector<double, CountingAllocator<double>> freqs_;
+    std::size_t garbage_size_ = 0;
+
+    void Compact();
+};
+
+// Слова документа с частотами, как их возвращает SearchServer::GetWordFrequencies
+class WordFrequencies {
+public:
+    // Указывает в массивы индекса, а не на WordFrequencies, поэтому переживает временный объект,
+    // из которого получен, но, как и строка, действителен только до изменения индекса
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator() = default;
+        Iterator(const TermId* term, const double* freq, const TermDictionary* terms);
+
+        value_type operator*() const;
+        Iterator& operator++();
+        Iterator operator++(int);
+
+        bool operator==(const Iterator& other) const;
+        bool operator!=(const Iterator& other) const;
+
+    private:
+        const TermId* term_ = nullptr;
+        const double* freq_ = nullptr;
+        const TermDictionary* terms_ = nullptr;
+    };
+
+    WordFrequencies() = default;
+    WordFrequencies(ForwardIndex::Row row, const TermDictionary& terms);
+
+    Iterator begin() const;
+    Iterator end() const;
+
+    std::size_t size() const;
+    bool empty() const;
+
+    std::optional<double> Find(std::string_view word) const;
+
+private:
+    ForwardIndex::Row row_;
+    const TermDictionary* terms_ = nullptr;
+};
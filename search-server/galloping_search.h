@@ -0,0 +1,23 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+
+// Аналог std::lower_bound для случая, когда искомый элемент, скорее всего,
+// находится недалеко от first: шаг поиска удваивается, пока не будет перепрыгнут
+// value, после чего выполняется двоичный поиск в последнем отрезке.
+// Стоимость — O(log d), где d — расстояние от first до результата.
+template <typename RandomIt, typename T, typename Compare>
+RandomIt GallopingLowerBound(RandomIt first, RandomIt last, const T& value, Compare comp) {
+    using Difference = typename std::iterator_traits<RandomIt>::difference_type;
+
+    const Difference size = last - first;
+    Difference step = 1;
+    Difference bound = 0;
+    while (bound < size && comp(first[bound], value)) {
+        bound += step;
+        step *= 2;
+    }
+    const Difference low = bound == 0 ? 0 : bound - step / 2 + 1;
+    return std::lower_bound(first + low, first + std::min(bound, size), value, comp);
+}
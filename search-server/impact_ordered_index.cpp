@@ -0,0 +1,119 @@
+#include "impact_ordered_index.h"
+
+using namespace std;
+
+ImpactOrderedIndex::ImpactOrderedIndex(size_t min_posting_count)
+    : min_posting_count_(min_posting_count) {
+}
+
+ImpactOrderedIndex::ImpactOrderedIndex(const ImpactOrderedIndex& other)
+    : min_posting_count_(other.min_posting_count_) {
+    lock_guard guard(other.merge_mutex_);
+    postings_ = other.postings_;
+}
+
+ImpactOrderedIndex::ImpactOrderedIndex(ImpactOrderedIndex&& other)
+    : min_posting_count_(other.min_posting_count_)
+    , postings_(move(other.postings_)) {
+}
+
+ImpactOrderedIndex& ImpactOrderedIndex::operator=(const ImpactOrderedIndex& other) {
+    if (this != &other) {
+        lock_guard guard(other.merge_mutex_);
+        min_posting_count_ = other.min_posting_count_;
+        postings_ = other.postings_;
+    }
+    return *this;
+}
+
+ImpactOrderedIndex& ImpactOrderedIndex::operator=(ImpactOrderedIndex&& other) {
+    min_posting_count_ = other.min_posting_count_;
+    postings_ = move(other.postings_);
+    return *this;
+}
+
+ImpactOrderedIndex::TermPostings::TermPostings(const allocator_type& allocator)
+    : ordered(allocator)
+    , added(allocator)
+    , removed(allocator) {
+}
+
+ImpactOrderedIndex::TermPostings::TermPostings(const TermPostings& other, const allocator_type& allocator)
+    : ordered(other.ordered, allocator)
+    , added(other.added, allocator)
+    , removed(other.removed, allocator) {
+}
+
+size_t ImpactOrderedIndex::GetMinPostingCount() const {
+    return min_posting_count_;
+}
+
+void ImpactOrderedIndex::Remove(TermId term, uint32_t document, double term_freq, size_t posting_count) {
+    const auto it = postings_.find(term);
+    if (it == postings_.end()) {
+        return;
+    }
+    // Копия удаляется, только когда список стал вдвое короче порога, чтобы не перестраивать её на границе
+    if (posting_count < min_posting_count_ / 2) {
+        postings_.erase(it);
+        return;
+    }
+    it->second.removed.push_back({document, term_freq});
+}
+
+const ImpactOrderedIndex::Postings* ImpactOrderedIndex::Find(TermId term) const {
+    const auto it = postings_.find(term);
+    if (it == postings_.end()) {
+        return nullptr;
+    }
+    TermPostings& term_postings = it->second;
+    lock_guard guard(merge_mutex_);
+    if (!term_postings.added.empty() || !term_postings.removed.empty()) {
+        Merge(term_postings);
+    }
+    return &term_postings.ordered;
+}
+
+MemoryUsage ImpactOrderedIndex::GetMemoryUsage() const {
+    return postings_.get_allocator().outer_allocator().GetUsage();
+}
+
+bool ImpactOrderedIndex::IsBefore(const Posting& lhs, const Posting& rhs) {
+    if (lhs.term_freq != rhs.term_freq) {
+        return lhs.term_freq > rhs.term_freq;
+    }
+    return lhs.document < rhs.document;
+}
+
+void ImpactOrderedIndex::Merge(TermPostings& postings) {
+    sort(postings.added.begin(), postings.added.end(), IsBefore);
+    sort(postings.removed.begin(), postings.removed.end(), IsBefore);
+
+    // Каждая удалённая запись совпадает с одной записью копии или добавленных, и все три последовательности
+    // упорядочены одинаково, поэтому удалённые вычёркиваются за тот же проход слияния
+    Postings merged(postings.ordered.get_allocator());
+    merged.reserve(postings.ordered.size() + postings.added.size());
+    auto removed = postings.removed.begin();
+    const auto append = [&merged, &removed, &postings](const Posting& posting) {
+        if (removed != postings.removed.end() && removed->document == posting.document && removed->term_freq == posting.term_freq) {
+            ++removed;
+            return;
+        }
+        merged.push_back(posting);
+    };
+    auto ordered = postings.ordered.begin();
+    for (const Posting& added : postings.added) {
+        for (; ordered != postings.ordered.end() && !IsBefore(added, *ordered); ++ordered) {
+            append(*ordered);
+        }
+        append(added);
+    }
+    for (; ordered != postings.ordered.end(); ++ordered) {
+        append(*ordered);
+    }
+
+    postings.ordered = move(merged);
+    // Буферы после массового добавления велики, их память освобождается
+    postings.added = Postings(postings.ordered.get_allocator());
+    postings.removed = Postings(postings.ordered.get_allocator());
+}
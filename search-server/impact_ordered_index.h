@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <scoped_allocator>
+#include <utility>
+#include <vector>
+
+#include "memory_accounting.h"
+#include "term_dictionary.h"
+
+// Копии длинных списков документов, упорядоченные по убыванию частоты слова в документе.
+// IDF у всех записей слова общий, поэтому это и порядок убывания вклада в релевантность:
+// короткому запросу достаточно прочитать начало таких списков.
+// Изменения копятся в буферах слова и сливаются с копией при первом поиске по этому слову,
+// так что добавление документа не сдвигает уже упорядоченные записи.
+class ImpactOrderedIndex {
+public:
+    struct Posting {
+        std::uint32_t document;
+        double term_freq;
+    };
+
+    using Postings = std::vector<Posting, CountingAllocator<Posting>>;
+
+    // Порог, при котором не копируется ни один список
+    static constexpr std::size_t DISABLED = 0;
+
+    // Списки короче min_posting_count не копируются
+    explicit ImpactOrderedIndex(std::size_t min_posting_count = DISABLED);
+
+    // Мьютекс слияния не копируется и не перемещается
+    ImpactOrderedIndex(const ImpactOrderedIndex& other);
+    ImpactOrderedIndex(ImpactOrderedIndex&& other);
+    ImpactOrderedIndex& operator=(const ImpactOrderedIndex& other);
+    ImpactOrderedIndex& operator=(ImpactOrderedIndex&& other);
+
+    std::size_t GetMinPostingCount() const;
+
+    // Копирует список слова, если порог задан и список не короче его; упорядочивается копия при первом поиске
+    template <typename DocumentPostings>
+    void Build(TermId term, const DocumentPostings& postings);
+
+    // Вызываются после изменения обычного списка слова; postings — его новое содержимое
+    template <typename DocumentPostings>
+    void Add(TermId term, std::uint32_t document, double term_freq, const DocumentPostings& postings);
+    void Remove(TermId term, std::uint32_t document, double term_freq, std::size_t posting_count);
+
+    // nullptr, если список слова слишком короткий. Поиски из нескольких потоков допустимы,
+    // пока индекс не меняется: накопленные изменения сливаются под мьютексом
+    const Postings* Find(TermId term) const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    struct TermPostings {
+        using allocator_type = CountingAllocator<Posting>;
+
+        Postings ordered;
+        // Изменения, ещё не слитые с ordered
+        Postings added;
+        Postings removed;
+
+        explicit TermPostings(const allocator_type& allocator);
+        TermPostings(const TermPostings& other, const allocator_type& allocator);
+    };
+
+    std::size_t min_posting_count_;
+    mutable std::mutex merge_mutex_;
+    mutable std::map<TermId, TermPostings, std::less<TermId>,
+                     std::scoped_allocator_adaptor<CountingAllocator<std::pair<const TermId, TermPostings>>>> postings_;
+
+    // По убыванию частоты, при равенстве — по возрастанию документа
+    static bool IsBefore(const Posting& lhs, const Posting& rhs);
+
+    static void Merge(TermPostings& postings);
+};
+
+template <typename DocumentPostings>
+void ImpactOrderedIndex::Add(TermId term, std::uint32_t document, double term_freq, const DocumentPostings& postings) {
+    const auto it = postings_.find(term);
+    if (it != postings_.end()) {
+        it->second.added.push_back({document, term_freq});
+        return;
+    }
+    Build(term, postings);
+}
+
+template <typename DocumentPostings>
+void ImpactOrderedIndex::Build(TermId term, const DocumentPostings& postings) {
+    if (min_posting_count_ == DISABLED || postings.size() < min_posting_count_) {
+        return;
+    }
+    auto& term_postings = postings_.try_emplace(term).first->second;
+    term_postings.ordered.clear();
+    term_postings.removed.clear();
+    term_postings.added.clear();
+    term_postings.added.reserve(postings.size());
+    for (const auto& posting : postings) {
+        term_postings.added.push_back({posting.document, posting.term_freq});
+    }
+}
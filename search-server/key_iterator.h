@@ -0,0 +1,62 @@
+#pragma once
+
+#include <iterator>
+#include <type_traits>
+
+// Итератор по ключам ассоциативного контейнера
+template <typename MapIterator>
+class KeyIterator {
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::remove_const_t<typename std::iterator_traits<MapIterator>::value_type::first_type>;
+    using difference_type = typename std::iterator_traits<MapIterator>::difference_type;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    KeyIterator() = default;
+
+    explicit KeyIterator(MapIterator it)
+        : it_(it) {
+    }
+
+    reference operator*() const {
+        return it_->first;
+    }
+
+    pointer operator->() const {
+        return &it_->first;
+    }
+
+    KeyIterator& operator++() {
+        ++it_;
+        return *this;
+    }
+
+    KeyIterator operator++(int) {
+        KeyIterator result = *this;
+        ++it_;
+        return result;
+    }
+
+    KeyIterator& operator--() {
+        --it_;
+        return *this;
+    }
+
+    KeyIterator operator--(int) {
+        KeyIterator result = *this;
+        --it_;
+        return result;
+    }
+
+    bool operator==(const KeyIterator& other) const {
+        return it_ == other.it_;
+    }
+
+    bool operator!=(const KeyIterator& other) const {
+        return it_ != other.it_;
+    }
+
+private:
+    MapIterator it_;
+};
@@ -74,6 +74,10 @@ int main() {
 
         TEST(seq);
         TEST(par);
+        Test("auto"sv, search_server, queries, execution_auto);
+
+        search_server.QuantizeImpacts(ImpactPrecision::BITS_16);
+        Test("quantized"sv, search_server, queries, execution_quantized);
     }
 }
 
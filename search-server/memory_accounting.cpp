@@ -0,0 +1,77 @@
+#include "memory_accounting.h"
+
+#include <algorithm>
+
+using namespace std;
+
+MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& other) {
+    bytes += other.bytes;
+    footprint += other.footprint;
+    allocations += other.allocations;
+    return *this;
+}
+
+size_t EstimateAllocationFootprint(size_t size) {
+    static const size_t header_size = sizeof(size_t);
+    static const size_t alignment = 2 * sizeof(size_t);
+    static const size_t min_chunk_size = 4 * sizeof(size_t);
+
+    const size_t chunk_size = (size + header_size + alignment - 1) / alignment * alignment;
+    return max(chunk_size, min_chunk_size);
+}
+
+void AllocationCounter::Allocate(size_t size) {
+    bytes.fetch_add(size, memory_order_relaxed);
+    footprint.fetch_add(EstimateAllocationFootprint(size), memory_order_relaxed);
+    allocations.fetch_add(1, memory_order_relaxed);
+}
+
+void AllocationCounter::Deallocate(size_t size) {
+    bytes.fetch_sub(size, memory_order_relaxed);
+    footprint.fetch_sub(EstimateAllocationFootprint(size), memory_order_relaxed);
+    allocations.fetch_sub(1, memory_order_relaxed);
+}
+
+MemoryUsage AllocationCounter::GetUsage() const {
+    return {
+        bytes.load(memory_order_relaxed),
+        footprint.load(memory_order_relaxed),
+        allocations.load(memory_order_relaxed)};
+}
+
+void AddStringUsage(MemoryUsage& usage, const string& str) {
+    static const size_t sso_capacity = string{}.capacity();
+    if (str.capacity() > sso_capacity) {
+        const size_t size = str.capacity() + 1;
+        usage.bytes += size;
+        usage.footprint += EstimateAllocationFootprint(size);
+        ++usage.allocations;
+    }
+}
+
+MemoryUsage IndexMemoryReport::GetTotal() const {
+    MemoryUsage total;
+    for (const auto& structure : structures) {
+        total += structure.usage;
+    }
+    return total;
+}
+
+ostream& operator<<(ostream& out, const MemoryUsage& usage) {
+    out << "{ "s
+        << "bytes = "s << usage.bytes << ", "s
+        << "footprint = "s << usage.footprint << ", "s
+        << "allocations = "s << usage.allocations << " }"s;
+    return out;
+}
+
+ostream& operator<<(ostream& out, const IndexMemoryReport& report) {
+    for (const auto& [name, usage] : report.structures) {
+        out << name << ": "s << usage << endl;
+    }
+    out << "total: "s << report.GetTotal() << endl
+        << "terms = "s << report.term_count << ", "s
+        << "postings = "s << report.posting_count << ", "s
+        << "average posting length = "s << report.average_posting_length;
+    return out;
+}
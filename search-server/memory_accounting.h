@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+struct MemoryUsage {
+    // Запрошено у аллокатора
+    std::size_t bytes = 0;
+    // С учётом служебных данных и выравнивания блоков malloc
+    std::size_t footprint = 0;
+    std::size_t allocations = 0;
+
+    MemoryUsage& operator+=(const MemoryUsage& other);
+};
+
+// Оценка размера блока, который malloc (glibc) выделит под запрос в size байт
+std::size_t EstimateAllocationFootprint(std::size_t size);
+
+struct AllocationCounter {
+    std::atomic<std::size_t> bytes{0};
+    std::atomic<std::size_t> footprint{0};
+    std::atomic<std::size_t> allocations{0};
+
+    void Allocate(std::size_t size);
+    void Deallocate(std::size_t size);
+    MemoryUsage GetUsage() const;
+};
+
+// Аллокатор, учитывающий все выделения контейнера в общем счётчике.
+// Счётчик разделяется копиями аллокатора (в том числе после rebind),
+// а копия контейнера получает собственный счётчик.
+template <typename T>
+class CountingAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    CountingAllocator()
+        : counter_(std::make_shared<AllocationCounter>()) {
+    }
+
+    // Перемещение намеренно копирует счётчик: контейнер, из которого переместили, остаётся пригодным
+    CountingAllocator(const CountingAllocator&) = default;
+    CountingAllocator& operator=(const CountingAllocator&) = default;
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) noexcept
+        : counter_(other.counter_) {
+    }
+
+    T* allocate(std::size_t n) {
+        T* result = std::allocator<T>{}.allocate(n);
+        counter_->Allocate(n * sizeof(T));
+        return result;
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        std::allocator<T>{}.deallocate(p, n);
+        counter_->Deallocate(n * sizeof(T));
+    }
+
+    CountingAllocator select_on_container_copy_construction() const {
+        return {};
+    }
+
+    MemoryUsage GetUsage() const {
+        return counter_->GetUsage();
+    }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U>& other) const {
+        return counter_ == other.counter_;
+    }
+
+    template <typename U>
+    bool operator!=(const CountingAllocator<U>& other) const {
+        return !(*this == other);
+    }
+
+private:
+    template <typename U>
+    friend class CountingAllocator;
+
+    std::shared_ptr<AllocationCounter> counter_;
+};
+
+// Строки, не поместившиеся в SSO-буфер, выделяют память стандартным аллокатором
+void AddStringUsage(MemoryUsage& usage, const std::string& str);
+
+struct StructureMemoryUsage {
+    std::string name;
+    MemoryUsage usage;
+};
+
+struct IndexMemoryReport {
+    std::vector<StructureMemoryUsage> structures;
+
+    std::size_t term_count = 0;
+    std::size_t posting_count = 0;
+    double average_posting_length = 0.0;
+
+    MemoryUsage GetTotal() const;
+};
+
+std::ostream& operator<<(std::ostream& out, const MemoryUsage& usage);
+std::ostream& operator<<(std::ostream& out, const IndexMemoryReport& report);
@@ -3,6 +3,13 @@
 #include <vector>
 #include <algorithm>
 #include <cassert>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "search_server.h"
 
 template <typename Iterator>
 class IteratorRange {
@@ -70,3 +77,88 @@ template <typename Container>
 auto Paginate(const Container& c, std::size_t page_size) {
     return Paginator(begin(c), end(c), page_size);
 }
+
+// Страницы запрашиваются у источника по одной при продвижении итератора.
+// PageSource возвращает очередную страницу-контейнер; пустая страница означает конец.
+template <typename PageSource>
+class LazyPaginator {
+public:
+    using Page = std::invoke_result_t<PageSource&>;
+    using PageRange = IteratorRange<typename Page::const_iterator>;
+
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = PageRange;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const PageRange*;
+        using reference = PageRange;
+
+        Iterator() = default;
+
+        explicit Iterator(PageSource* source)
+            : source_(source) {
+            Fetch();
+        }
+
+        PageRange operator*() const {
+            return {page_.begin(), page_.end()};
+        }
+
+        Iterator& operator++() {
+            Fetch();
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return source_ == other.source_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        void Fetch() {
+            page_ = (*source_)();
+            if (page_.empty()) {
+                source_ = nullptr;
+            }
+        }
+
+        PageSource* source_ = nullptr;
+        Page page_;
+    };
+
+    explicit LazyPaginator(PageSource source)
+        : source_(std::move(source)) {
+    }
+
+    // Обход однопроходный: повторный вызов begin() продолжает с текущей страницы
+    Iterator begin() {
+        return Iterator(&source_);
+    }
+
+    Iterator end() {
+        return {};
+    }
+
+private:
+    PageSource source_;
+};
+
+// Запрос копируется в пагинатор: строка, из которой он передан, может не дожить до следующей страницы.
+// Вместо предиката можно передать DocumentStatus
+template <typename DocumentPredicate>
+auto Paginate(const SearchServer& search_server, std::string_view raw_query, DocumentPredicate document_predicate, std::size_t page_size) {
+    assert(page_size > 0);
+    return LazyPaginator([&search_server, query = std::string(raw_query), document_predicate, page_size, cursor = SearchCursor{}]() mutable {
+        auto page = search_server.FindDocumentsPage(query, document_predicate, cursor, page_size);
+        cursor = page.next;
+        return std::move(page.documents);
+    });
+}
+
+inline auto Paginate(const SearchServer& search_server, std::string_view raw_query, std::size_t page_size) {
+    return Paginate(search_server, raw_query, DocumentStatus::ACTUAL, page_size);
+}
@@ -5,9 +5,8 @@
 #include <vector>
 #include <string>
 #include <algorithm>
-#include <execution>
+#include <iterator>
 #include <list>
-#include <numeric>
 
 using namespace std;
 
@@ -15,34 +14,38 @@ vector<vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const vector<string>& queries) {
 
-    vector<vector<Document>> documents(queries.size());
-    transform(
-            execution::par,
-            queries.begin(), queries.end(),
-            documents.begin(),
-            [&search_server](const string& query){
-                return search_server.FindTopDocuments(query);
-            });
-    return documents;
+    return ProcessQueriesInPool(search_server, queries, ThreadPool::GetDefault());
 }
 
-
 list<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const vector<string>& queries) {
 
-    return transform_reduce(
-            execution::par,
-            queries.begin(), queries.end(),
-            list<Document>{},
-            [](const auto& lhs_, const auto& rhs_) {
-                auto lhs = const_cast<list<Document>&>(lhs_);
-                auto rhs = const_cast<list<Document>&>(rhs_);
-                lhs.splice(lhs.end(), rhs);
-                return lhs;
-            },
-            [&search_server](const string& query) {
-                const auto documents = search_server.FindTopDocuments(query);
-                return list<Document>{documents.begin(), documents.end()};;
+    return ProcessQueriesJoinedInPool(search_server, queries, ThreadPool::GetDefault());
+}
+
+vector<vector<Document>> ProcessQueriesInPool(
+    const SearchServer& search_server,
+    const vector<string>& queries,
+    ThreadPool& pool) {
+
+    vector<vector<Document>> documents(queries.size());
+    pool.ParallelFor(
+            0, queries.size(),
+            [&search_server, &queries, &documents](size_t index) {
+                documents[index] = search_server.FindTopDocuments(queries[index]);
             });
+    return documents;
+}
+
+list<Document> ProcessQueriesJoinedInPool(
+    const SearchServer& search_server,
+    const vector<string>& queries,
+    ThreadPool& pool) {
+
+    list<Document> joined;
+    for (const auto& documents : ProcessQueriesInPool(search_server, queries, pool)) {
+        copy(documents.begin(), documents.end(), back_inserter(joined));
+    }
+    return joined;
 }
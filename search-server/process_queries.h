@@ -2,11 +2,13 @@
 
 #include "document.h"
 #include "search_server.h"
+#include "thread_pool.h"
 
 #include <vector>
 #include <string>
 #include <list>
 
+// Запросы выполняются в общем пуле ThreadPool::GetDefault()
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
@@ -14,3 +16,14 @@ std::vector<std::vector<Document>> ProcessQueries(
 std::list<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
+
+// То же в переданном пуле, например отдельном от пула индексации
+std::vector<std::vector<Document>> ProcessQueriesInPool(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    ThreadPool& pool);
+
+std::list<Document> ProcessQueriesJoinedInPool(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    ThreadPool& pool);
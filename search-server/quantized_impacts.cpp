@@ -0,0 +1,88 @@
+#include "quantized_impacts.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+// Ветвлений в цикле нет, массивы раздельные: узкое место — разброс по accumulator
+template <typename Impact>
+void AccumulateImpacts(const uint32_t* documents, const Impact* impacts, size_t size, uint32_t* accumulator, uint8_t* is_hit) {
+    for (size_t i = 0; i < size; ++i) {
+        accumulator[documents[i]] += impacts[i];
+        is_hit[documents[i]] = 1;
+    }
+}
+
+} // namespace
+
+QuantizedImpacts::QuantizedImpacts(ImpactPrecision precision, double max_impact)
+    : precision_(precision) {
+    const double max_code = precision_ == ImpactPrecision::BITS_8
+            ? numeric_limits<uint8_t>::max()
+            : numeric_limits<uint16_t>::max();
+    if (max_impact > 0) {
+        scale_ = max_impact / max_code;
+    }
+    term_offsets_.push_back(0);
+}
+
+void QuantizedImpacts::Add(uint32_t document, double impact) {
+    documents_.push_back(document);
+    const double code = round(impact / scale_);
+    if (precision_ == ImpactPrecision::BITS_8) {
+        impacts8_.push_back(static_cast<uint8_t>(code));
+    } else {
+        impacts16_.push_back(static_cast<uint16_t>(code));
+    }
+}
+
+void QuantizedImpacts::FinishTerm() {
+    term_offsets_.push_back(documents_.size());
+}
+
+bool QuantizedImpacts::empty() const {
+    return term_offsets_.empty();
+}
+
+size_t QuantizedImpacts::GetTermCount() const {
+    return empty() ? 0 : term_offsets_.size() - 1;
+}
+
+ImpactPrecision QuantizedImpacts::GetPrecision() const {
+    return precision_;
+}
+
+double QuantizedImpacts::GetScale() const {
+    return scale_;
+}
+
+double QuantizedImpacts::GetMaxError() const {
+    return scale_ / 2;
+}
+
+void QuantizedImpacts::Accumulate(TermId term, uint32_t* accumulator, uint8_t* is_hit) const {
+    const size_t begin = term_offsets_[term];
+    const size_t size = term_offsets_[term + 1] - begin;
+    if (precision_ == ImpactPrecision::BITS_8) {
+        AccumulateImpacts(documents_.data() + begin, impacts8_.data() + begin, size, accumulator, is_hit);
+    } else {
+        AccumulateImpacts(documents_.data() + begin, impacts16_.data() + begin, size, accumulator, is_hit);
+    }
+}
+
+void QuantizedImpacts::Exclude(TermId term, uint8_t* is_hit) const {
+    for (size_t i = term_offsets_[term]; i < term_offsets_[term + 1]; ++i) {
+        is_hit[documents_[i]] = 0;
+    }
+}
+
+MemoryUsage QuantizedImpacts::GetMemoryUsage() const {
+    MemoryUsage usage = term_offsets_.get_allocator().GetUsage();
+    usage += documents_.get_allocator().GetUsage();
+    usage += impacts8_.get_allocator().GetUsage();
+    usage += impacts16_.get_allocator().GetUsage();
+    return usage;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "memory_accounting.h"
+#include "term_dictionary.h"
+
+// Политика поиска по квантованным вкладам, см. SearchServer::QuantizeImpacts
+struct QuantizedExecutionPolicy {};
+
+inline constexpr QuantizedExecutionPolicy execution_quantized{};
+
+enum class ImpactPrecision {
+    BITS_8,
+    BITS_16,
+};
+
+// Снимок списков документов, в котором вместо частоты слова хранится вклад tf×idf,
+// квантованный до 8 или 16 бит с общим для всех слов масштабом. Идентификаторы документов
+// и вклады лежат раздельными массивами по словам подряд: 5 или 6 байт на запись вместо 16,
+// а релевантность копится целыми числами. Ошибка вклада каждого слова не превышает GetMaxError().
+class QuantizedImpacts {
+public:
+    QuantizedImpacts() = default;
+    // max_impact — наибольший вклад, он кодируется наибольшим значением
+    QuantizedImpacts(ImpactPrecision precision, double max_impact);
+
+    // Записи добавляются по словам в порядке TermId, каждое слово завершается FinishTerm
+    void Add(std::uint32_t document, double impact);
+    void FinishTerm();
+
+    bool empty() const;
+    std::size_t GetTermCount() const;
+    ImpactPrecision GetPrecision() const;
+    double GetScale() const;
+    double GetMaxError() const;
+
+    // Прибавляет коды вкладов слова к accumulator и отмечает его документы в is_hit
+    void Accumulate(TermId term, std::uint32_t* accumulator, std::uint8_t* is_hit) const;
+    // Снимает отметки с документов слова
+    void Exclude(TermId term, std::uint8_t* is_hit) const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    ImpactPrecision precision_ = ImpactPrecision::BITS_16;
+    double scale_ = 1.0;
+    std::vector<std::size_t, CountingAllocator<std::size_t>> term_offsets_;
+    std::vector<std::uint32_t, CountingAllocator<std::uint32_t>> documents_;
+    std::vector<std::uint8_t, CountingAllocator<std::uint8_t>> impacts8_;
+    std::vector<std::uint16_t, CountingAllocator<std::uint16_t>> impacts16_;
+};
@@ -0,0 +1,91 @@
+#include "query_planner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace std;
+
+namespace {
+
+// Стоимости в условных единицах: одна единица — просмотр записи списка документов
+const double ACCUMULATOR_COST_PER_DOCUMENT = 0.25;
+const double ACCUMULATE_COST = 1.0;
+const double HEAP_COST = 1.0;
+const double BITMAP_COST_PER_DOCUMENT = 1.0 / 64;
+const double BITMAP_TEST_COST = 0.5;
+const double PARALLEL_STARTUP_COST = 50'000.0;
+
+double Sum(const vector<size_t>& counts) {
+    return accumulate(counts.begin(), counts.end(), 0.0);
+}
+
+} // namespace
+
+QueryPlan PlanQuery(const QueryStatistics& statistics) {
+    const auto& plus_counts = statistics.plus_posting_counts;
+
+    QueryPlan plan;
+    const double plus_postings = Sum(plus_counts);
+    const double minus_postings = Sum(statistics.minus_posting_counts);
+    const double accepted_postings = plus_postings * statistics.filter_selectivity;
+    const double document_count = static_cast<double>(statistics.document_count);
+    const size_t scored_terms = count_if(plus_counts.begin(), plus_counts.end(), [](size_t count) {
+        return count > 0;
+    });
+
+    // Обход по словам платит за обнуление массива по всем документам,
+    // слияние списков — за кучу курсоров на каждой записи
+    const double term_at_a_time_cost = plus_postings
+            + accepted_postings * ACCUMULATE_COST
+            + document_count * ACCUMULATOR_COST_PER_DOCUMENT;
+    const double document_at_a_time_cost = plus_postings
+            * (1.0 + HEAP_COST * log2(static_cast<double>(max<size_t>(scored_terms, 1))));
+
+    if (document_at_a_time_cost < term_at_a_time_cost) {
+        plan.strategy = QueryStrategy::DOCUMENT_AT_A_TIME;
+        plan.estimated_cost = document_at_a_time_cost;
+        return plan;
+    }
+
+    plan.strategy = QueryStrategy::TERM_AT_A_TIME;
+    plan.estimated_cost = term_at_a_time_cost;
+
+    // Предварительная битовая карта окупается, если минус-слова отсекают заметную долю
+    // принятых записей: считаем, что документ содержит минус-слово с вероятностью minus / N
+    if (minus_postings > 0 && document_count > 0) {
+        const double excluded_share = min(1.0, minus_postings / document_count);
+        const double prefilter_cost = document_count * BITMAP_COST_PER_DOCUMENT + plus_postings * BITMAP_TEST_COST;
+        plan.prefilter_minus_words = prefilter_cost < accepted_postings * ACCUMULATE_COST * excluded_share;
+    }
+
+    // Параллельная версия делит диапазон документов между потоками и платит только за запуск задач
+    const unsigned workers = max(statistics.thread_count, 1u);
+    if (workers > 1) {
+        const double parallel_cost = PARALLEL_STARTUP_COST + term_at_a_time_cost / workers;
+        if (parallel_cost < plan.estimated_cost) {
+            plan.is_parallel = true;
+            plan.estimated_cost = parallel_cost;
+        }
+    }
+    return plan;
+}
+
+ostream& operator<<(ostream& out, QueryStrategy strategy) {
+    switch (strategy) {
+        case QueryStrategy::TERM_AT_A_TIME:
+            return out << "term-at-a-time"s;
+        case QueryStrategy::DOCUMENT_AT_A_TIME:
+            return out << "document-at-a-time"s;
+    }
+    return out;
+}
+
+ostream& operator<<(ostream& out, const QueryPlan& plan) {
+    out << "{ "s
+        << "strategy = "s << plan.strategy << ", "s
+        << "prefilter minus words = "s << boolalpha << plan.prefilter_minus_words << ", "s
+        << "parallel = "s << plan.is_parallel << noboolalpha << ", "s
+        << "cost = "s << plan.estimated_cost << " }"s;
+    return out;
+}
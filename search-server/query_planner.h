@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+// Политика выполнения, при которой стратегию запроса выбирает планировщик
+struct AutoExecutionPolicy {};
+
+inline constexpr AutoExecutionPolicy execution_auto{};
+
+enum class QueryStrategy {
+    // Слова обходятся по очереди, релевантность копится в плотном массиве по всем документам
+    TERM_AT_A_TIME,
+    // Списки документов сливаются одновременно, каждый документ оценивается целиком
+    DOCUMENT_AT_A_TIME,
+};
+
+// То, что известно о запросе до его выполнения
+struct QueryStatistics {
+    // Длины списков документов слов в порядке слов запроса; отсутствующим словам соответствует 0
+    std::vector<std::size_t> plus_posting_counts;
+    std::vector<std::size_t> minus_posting_counts;
+    // Размер плотного массива релевантности, включая слоты удалённых документов
+    std::size_t document_count = 0;
+    // Доля документов, проходящих фильтр; 1, если фильтр — произвольный предикат
+    double filter_selectivity = 1.0;
+    unsigned thread_count = 1;
+};
+
+// Слова запроса при любой стратегии складываются в порядке запроса, поэтому релевантность от плана не зависит
+struct QueryPlan {
+    QueryStrategy strategy = QueryStrategy::TERM_AT_A_TIME;
+    // Только для обхода по словам: документы с минус-словами исключаются битовой картой до подсчёта релевантности,
+    // а не после. Слияние списков и так проверяет курсоры минус-слов до оценки документа
+    bool prefilter_minus_words = false;
+    bool is_parallel = false;
+    // Оценка стоимости выбранного плана в условных операциях над записями списков
+    double estimated_cost = 0.0;
+};
+
+QueryPlan PlanQuery(const QueryStatistics& statistics);
+
+std::ostream& operator<<(std::ostream& out, QueryStrategy strategy);
+std::ostream& operator<<(std::ostream& out, const QueryPlan& plan);
@@ -0,0 +1,64 @@
+#include "query_profile.h"
+
+using namespace std;
+
+namespace {
+
+void PrintTerms(ostream& out, const vector<QueryTermProfile>& terms) {
+    out << '[';
+    bool is_first = true;
+    for (const auto& term : terms) {
+        if (!is_first) {
+            out << ", "s;
+        }
+        is_first = false;
+        out << term;
+    }
+    out << ']';
+}
+
+} // namespace
+
+ostream& operator<<(ostream& out, QueryExecution execution) {
+    switch (execution) {
+        case QueryExecution::TERM_TOP_DOCUMENTS:
+            return out << "term-top-documents"s;
+        case QueryExecution::IMPACT_ORDERED:
+            return out << "impact-ordered"s;
+        case QueryExecution::TERM_AT_A_TIME:
+            return out << "term-at-a-time"s;
+        case QueryExecution::DOCUMENT_AT_A_TIME:
+            return out << "document-at-a-time"s;
+        case QueryExecution::DOCUMENT_RANGES:
+            return out << "document-ranges"s;
+        case QueryExecution::QUANTIZED:
+            return out << "quantized"s;
+    }
+    return out;
+}
+
+ostream& operator<<(ostream& out, const QueryTermProfile& term) {
+    out << "{ "s
+        << "word = "s << term.word << ", "s
+        << "postings = "s << term.posting_count << ", "s
+        << "idf = "s << term.inverse_document_freq << " }"s;
+    return out;
+}
+
+ostream& operator<<(ostream& out, const QueryProfile& profile) {
+    using namespace chrono;
+
+    out << "execution = "s << profile.execution << endl << "plus terms = "s;
+    PrintTerms(out, profile.plus_terms);
+    out << endl << "minus terms = "s;
+    PrintTerms(out, profile.minus_terms);
+    out << endl
+        << "postings visited = "s << profile.postings_visited << ", "s
+        << "accepted = "s << profile.postings_accepted << ", "s
+        << "removed by minus words = "s << profile.documents_removed_by_minus_words << endl
+        << "parse = "s << duration_cast<microseconds>(profile.parse_time).count() << " us, "s
+        << "scoring = "s << duration_cast<microseconds>(profile.scoring_time).count() << " us, "s
+        << "minus words = "s << duration_cast<microseconds>(profile.minus_words_time).count() << " us, "s
+        << "ranking = "s << duration_cast<microseconds>(profile.ranking_time).count() << " us"s;
+    return out;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+struct QueryTermProfile {
+    // Слова, отсутствующие в индексе, ссылаются на текст запроса
+    std::string_view word;
+    std::size_t posting_count = 0;
+    double inverse_document_freq = 0.0;
+};
+
+// Способ, которым поиск нашёл выдачу
+enum class QueryExecution {
+    TERM_TOP_DOCUMENTS,
+    IMPACT_ORDERED,
+    TERM_AT_A_TIME,
+    DOCUMENT_AT_A_TIME,
+    DOCUMENT_RANGES,
+    QUANTIZED,
+};
+
+struct QueryProfile {
+    using Duration = std::chrono::nanoseconds;
+
+    QueryExecution execution = QueryExecution::TERM_AT_A_TIME;
+
+    std::vector<QueryTermProfile> plus_terms;
+    std::vector<QueryTermProfile> minus_terms;
+
+    std::size_t postings_visited = 0;
+    std::size_t postings_accepted = 0;
+    std::size_t documents_removed_by_minus_words = 0;
+
+    Duration parse_time{0};
+    Duration scoring_time{0};
+    Duration minus_words_time{0};
+    Duration ranking_time{0};
+};
+
+std::ostream& operator<<(std::ostream& out, QueryExecution execution);
+std::ostream& operator<<(std::ostream& out, const QueryTermProfile& term);
+std::ostream& operator<<(std::ostream& out, const QueryProfile& profile);
@@ -0,0 +1,390 @@
+#include "query_socket_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const int MAX_EVENTS = 256;
+const size_t READ_BLOCK_SIZE = 64 << 10;
+// Слушающие сокеты и событие остановки отличаются от клиентов по старшему биту
+const uint64_t LISTENER_TAG = uint64_t{1} << 63;
+const uint64_t STOP_TAG = LISTENER_TAG | (LISTENER_TAG >> 1);
+
+[[noreturn]] void ThrowSystemError(const string& what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+void AppendNumber(string& output, double value) {
+    char buffer[32];
+    const auto result = to_chars(buffer, buffer + sizeof(buffer), value);
+    output.append(buffer, result.ptr);
+}
+
+void AppendNumber(string& output, int value) {
+    char buffer[16];
+    const auto result = to_chars(buffer, buffer + sizeof(buffer), value);
+    output.append(buffer, result.ptr);
+}
+
+} // namespace
+
+string FormatQueryResponse(const vector<Document>& documents) {
+    string response = "OK"s;
+    for (const Document& document : documents) {
+        response.push_back(' ');
+        AppendNumber(response, document.id);
+        response.push_back(':');
+        AppendNumber(response, document.relevance);
+        response.push_back(':');
+        AppendNumber(response, document.rating);
+    }
+    return response;
+}
+
+QuerySocketServer::QuerySocketServer(const SearchServer& search_server, ThreadPool& pool, Options options)
+    : search_server_(search_server)
+    , pool_(pool)
+    , options_(options) {
+    epoll_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_ < 0) {
+        ThrowSystemError("Failed to create epoll"s);
+    }
+    stop_event_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stop_event_ < 0) {
+        const int error = errno;
+        ::close(epoll_);
+        throw system_error(error, generic_category(), "Failed to create eventfd"s);
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = STOP_TAG;
+    ::epoll_ctl(epoll_, EPOLL_CTL_ADD, stop_event_, &event);
+}
+
+QuerySocketServer::QuerySocketServer(const SearchServer& search_server, ThreadPool& pool)
+    : QuerySocketServer(search_server, pool, Options{}) {
+}
+
+QuerySocketServer::~QuerySocketServer() {
+    for (const auto& [id, connection] : connections_) {
+        ::close(connection.socket);
+    }
+    for (const int listener : listeners_) {
+        ::close(listener);
+    }
+    for (const auto& path : unix_paths_) {
+        ::unlink(path.c_str());
+    }
+    ::close(stop_event_);
+    ::close(epoll_);
+}
+
+void QuerySocketServer::ListenUnix(const string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw system_error(make_error_code(errc::filename_too_long), "Socket path is too long"s);
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    const int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        ThrowSystemError("Failed to create socket"s);
+    }
+    ::unlink(path.c_str());
+    if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0) {
+        const int error = errno;
+        ::close(listener);
+        throw system_error(error, generic_category(), "Failed to listen on "s + path);
+    }
+    unix_paths_.push_back(path);
+    AddListener(listener);
+}
+
+uint16_t QuerySocketServer::ListenTcp(uint16_t port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    const int listener = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        ThrowSystemError("Failed to create socket"s);
+    }
+    const int reuse = 1;
+    ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    socklen_t address_size = sizeof(address);
+    if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0
+            || ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &address_size) != 0) {
+        const int error = errno;
+        ::close(listener);
+        throw system_error(error, generic_category(), "Failed to listen on port "s + to_string(port));
+    }
+    AddListener(listener);
+    return ntohs(address.sin_port);
+}
+
+void QuerySocketServer::Run() {
+    epoll_event events[MAX_EVENTS];
+    while (true) {
+        const int event_count = ::epoll_wait(epoll_, events, MAX_EVENTS, GetTimeout());
+        if (event_count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait failed"s);
+        }
+        for (int i = 0; i < event_count; ++i) {
+            const uint64_t tag = events[i].data.u64;
+            if (tag == STOP_TAG) {
+                uint64_t value;
+                [[maybe_unused]] const ssize_t result = ::read(stop_event_, &value, sizeof(value));
+                return;
+            }
+            if (tag & LISTENER_TAG) {
+                Accept(static_cast<int>(tag & ~LISTENER_TAG));
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                Flush(tag);
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                Read(tag);
+            }
+        }
+        if (!pending_.empty() && GetTimeout() == 0) {
+            ExecuteBatch();
+        }
+    }
+}
+
+void QuerySocketServer::Stop() {
+    const uint64_t value = 1;
+    [[maybe_unused]] const ssize_t result = ::write(stop_event_, &value, sizeof(value));
+}
+
+size_t QuerySocketServer::GetRequestCount() const {
+    return request_count_.load();
+}
+
+size_t QuerySocketServer::GetBatchCount() const {
+    return batch_count_.load();
+}
+
+void QuerySocketServer::AddListener(int listener) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTENER_TAG | static_cast<uint64_t>(listener);
+    if (::epoll_ctl(epoll_, EPOLL_CTL_ADD, listener, &event) != 0) {
+        const int error = errno;
+        ::close(listener);
+        throw system_error(error, generic_category(), "Failed to watch listener"s);
+    }
+    listeners_.push_back(listener);
+}
+
+void QuerySocketServer::Accept(int listener) {
+    while (true) {
+        const int socket = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0) {
+            // EAGAIN — все ожидающие клиенты приняты; ошибки отдельного клиента не останавливают сервер
+            return;
+        }
+        const uint64_t connection_id = next_connection_id_++;
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.u64 = connection_id;
+        if (::epoll_ctl(epoll_, EPOLL_CTL_ADD, socket, &event) != 0) {
+            ::close(socket);
+            continue;
+        }
+        connections_.emplace(connection_id, Connection{socket, {}, {}, 0, false, event.events});
+    }
+}
+
+void QuerySocketServer::Read(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    Connection& connection = it->second;
+    // Входной буфер не больше блока чтения сверх max_request_size: чтение останавливается вместе с разбором
+    char buffer[READ_BLOCK_SIZE];
+    while (!connection.is_read_closed && !IsOverLimit(connection)) {
+        const ssize_t size = ::recv(connection.socket, buffer, sizeof(buffer), 0);
+        if (size > 0) {
+            connection.input.append(buffer, static_cast<size_t>(size));
+            if (!ParseRequests(connection_id, connection)) {
+                return;
+            }
+        } else if (size == 0) {
+            connection.is_read_closed = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            Close(connection_id);
+            return;
+        }
+    }
+    UpdateEvents(connection_id, connection);
+    CloseIfDone(connection_id);
+}
+
+bool QuerySocketServer::ParseRequests(uint64_t connection_id, Connection& connection) {
+    size_t line_begin = 0;
+    for (size_t line_end; !IsOverLimit(connection) && (line_end = connection.input.find('\n', line_begin)) != string::npos; line_begin = line_end + 1) {
+        size_t query_end = line_end;
+        if (query_end > line_begin && connection.input[query_end - 1] == '\r') {
+            --query_end;
+        }
+        if (pending_.empty()) {
+            batch_start_ = chrono::steady_clock::now();
+        }
+        pending_.push_back({connection_id, connection.input.substr(line_begin, query_end - line_begin)});
+        ++connection.pending_count;
+    }
+    connection.input.erase(0, line_begin);
+    // Отложенные из-за ограничений строки могут быть полными; длину проверяет только незавершённая строка
+    if (!IsOverLimit(connection) && connection.input.size() > options_.max_request_size) {
+        Close(connection_id);
+        return false;
+    }
+    return true;
+}
+
+bool QuerySocketServer::IsOverLimit(const Connection& connection) const {
+    return connection.pending_count >= max<size_t>(options_.max_pending_requests, 1) || connection.output.size() >= options_.max_output_size;
+}
+
+void QuerySocketServer::Flush(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    Connection& connection = it->second;
+    size_t written = 0;
+    while (written < connection.output.size()) {
+        // MSG_NOSIGNAL: отключившийся клиент не должен завершать сервер сигналом SIGPIPE
+        const ssize_t size = ::send(connection.socket, connection.output.data() + written, connection.output.size() - written, MSG_NOSIGNAL);
+        if (size >= 0) {
+            written += static_cast<size_t>(size);
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            Close(connection_id);
+            return;
+        }
+    }
+    connection.output.erase(0, written);
+
+    // Строки, прочитанные до того, как клиент упёрся в ограничения, разбираются, как только ответы ушли
+    if (!IsOverLimit(connection) && !ParseRequests(connection_id, connection)) {
+        return;
+    }
+    UpdateEvents(connection_id, connection);
+    CloseIfDone(connection_id);
+}
+
+void QuerySocketServer::UpdateEvents(uint64_t connection_id, Connection& connection) {
+    // Готовность к записи отслеживается, только пока ответы не помещаются в буфер сокета.
+    // Клиент сверх ограничений не читается, пока ответы ему не уйдут
+    const bool is_reading = !connection.is_read_closed && !IsOverLimit(connection);
+    const uint32_t events = (is_reading ? uint32_t{EPOLLIN | EPOLLRDHUP} : 0u) | (connection.output.empty() ? 0u : uint32_t{EPOLLOUT});
+    if (events != connection.events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = connection_id;
+        ::epoll_ctl(epoll_, EPOLL_CTL_MOD, connection.socket, &event);
+        connection.events = events;
+    }
+}
+
+void QuerySocketServer::CloseIfDone(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it != connections_.end() && it->second.is_read_closed && it->second.pending_count == 0 && it->second.output.empty()) {
+        Close(connection_id);
+    }
+}
+
+void QuerySocketServer::Close(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    // Закрытие дескриптора снимает его с epoll
+    ::close(it->second.socket);
+    connections_.erase(it);
+}
+
+void QuerySocketServer::ExecuteBatch() {
+    const size_t batch_size = min(pending_.size(), max<size_t>(options_.max_batch_size, 1));
+    vector<string> responses(batch_size);
+    pool_.ParallelFor(0, batch_size, [this, &responses](size_t index) {
+        try {
+            responses[index] = FormatQueryResponse(search_server_.FindTopDocuments(pending_[index].query));
+        } catch (const exception& e) {
+            responses[index] = "ERROR "s + e.what();
+        }
+    });
+    request_count_ += batch_size;
+    ++batch_count_;
+
+    // Ответы одного клиента идут в порядке его запросов, а записываются одним вызовом send
+    vector<uint64_t> touched;
+    for (size_t index = 0; index < batch_size; ++index) {
+        const auto it = connections_.find(pending_[index].connection_id);
+        if (it == connections_.end()) {
+            continue;
+        }
+        Connection& connection = it->second;
+        if (connection.output.empty()) {
+            touched.push_back(it->first);
+        }
+        connection.output += responses[index];
+        connection.output.push_back('\n');
+        --connection.pending_count;
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + batch_size);
+    if (!pending_.empty()) {
+        batch_start_ = chrono::steady_clock::now();
+    }
+    for (const uint64_t connection_id : touched) {
+        Flush(connection_id);
+    }
+}
+
+int QuerySocketServer::GetTimeout() const {
+    if (pending_.empty()) {
+        return -1;
+    }
+    if (pending_.size() >= options_.max_batch_size || options_.batch_delay.count() == 0) {
+        return 0;
+    }
+    const auto deadline = batch_start_ + options_.batch_delay;
+    const auto now = chrono::steady_clock::now();
+    if (now >= deadline) {
+        return 0;
+    }
+    // Округление вверх, чтобы не крутиться с нулевым тайм-аутом до срока
+    return static_cast<int>(chrono::ceil<chrono::milliseconds>(deadline - now).count());
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+#include "thread_pool.h"
+
+// Ответ на запрос: "OK" и документы "id:relevance:rating" через пробел; релевантность печатается без потери точности
+std::string FormatQueryResponse(const std::vector<Document>& documents);
+
+// Сервер запросов по строковому протоколу через Unix-сокет или TCP на localhost.
+// Запрос — строка текста запроса, ответ — строка FormatQueryResponse или "ERROR <сообщение>".
+// Клиент может отправлять запросы, не дожидаясь ответов: ответы приходят в порядке запросов.
+// Один поток обслуживает сокеты через epoll. Запросы, пришедшие от всех клиентов
+// за один проход цикла (и за batch_delay, если он задан), выполняются одним пакетом в пуле, как в ProcessQueries.
+// Сервер и пул должны пережить QuerySocketServer; индекс не должен меняться, пока работает Run.
+class QuerySocketServer {
+public:
+    struct Options {
+        std::size_t max_batch_size = 256;
+        // Сколько неполный пакет ждёт новых запросов; 0 — выполнять сразу после чтения сокетов
+        std::chrono::microseconds batch_delay{0};
+        // Клиент, приславший строку длиннее, отключается
+        std::size_t max_request_size = 64 << 10;
+        // Пока у клиента столько запросов без ответа или столько неотправленных байтов ответов,
+        // его сокет не читается: медленный клиент не может занять память сервера
+        std::size_t max_pending_requests = 1024;
+        std::size_t max_output_size = 1 << 20;
+    };
+
+    QuerySocketServer(const SearchServer& search_server, ThreadPool& pool, Options options);
+    QuerySocketServer(const SearchServer& search_server, ThreadPool& pool);
+
+    QuerySocketServer(const QuerySocketServer&) = delete;
+    QuerySocketServer& operator=(const QuerySocketServer&) = delete;
+
+    ~QuerySocketServer();
+
+    // Бросают std::system_error; существующий файл сокета заменяется
+    void ListenUnix(const std::string& path);
+    // Порт 0 — выбрать свободный; возвращает порт
+    std::uint16_t ListenTcp(std::uint16_t port);
+
+    // Обслуживает клиентов до вызова Stop
+    void Run();
+    // Можно вызвать из любого потока
+    void Stop();
+
+    std::size_t GetRequestCount() const;
+    std::size_t GetBatchCount() const;
+
+private:
+    struct Connection {
+        int socket;
+        std::string input;
+        std::string output;
+        // Запросы клиента, ответы на которые ещё не записаны в output
+        std::size_t pending_count = 0;
+        bool is_read_closed = false;
+        // События, на которые сокет подписан в epoll
+        std::uint32_t events = 0;
+    };
+
+    struct Request {
+        std::uint64_t connection_id;
+        std::string query;
+    };
+
+    const SearchServer& search_server_;
+    ThreadPool& pool_;
+    const Options options_;
+
+    int epoll_ = -1;
+    int stop_event_ = -1;
+    std::vector<int> listeners_;
+    std::vector<std::string> unix_paths_;
+
+    // Идентификаторы не переиспользуются, в отличие от дескрипторов сокетов
+    std::unordered_map<std::uint64_t, Connection> connections_;
+    std::uint64_t next_connection_id_ = 0;
+    std::vector<Request> pending_;
+    std::chrono::steady_clock::time_point batch_start_;
+
+    std::atomic<std::size_t> request_count_{0};
+    std::atomic<std::size_t> batch_count_{0};
+
+    void AddListener(int listener);
+    void Accept(int listener);
+    void Read(std::uint64_t connection_id);
+    // Переносит полные строки из input в pending_, пока клиент не упрётся в ограничения; false, если клиент отключён
+    bool ParseRequests(std::uint64_t connection_id, Connection& connection);
+    bool IsOverLimit(const Connection& connection) const;
+    void Flush(std::uint64_t connection_id);
+    void UpdateEvents(std::uint64_t connection_id, Connection& connection);
+    void CloseIfDone(std::uint64_t connection_id);
+    void Close(std::uint64_t connection_id);
+    void ExecuteBatch();
+    int GetTimeout() const;
+};
@@ -0,0 +1,43 @@
+#include "rating_index.h"
+
+#include <algorithm>
+
+using namespace std;
+
+void RatingIndex::Add(int rating, uint32_t document) {
+    auto& documents = buckets_[rating];
+    documents.insert(upper_bound(documents.begin(), documents.end(), document), document);
+}
+
+void RatingIndex::Remove(int rating, uint32_t document) {
+    const auto bucket = buckets_.find(rating);
+    if (bucket == buckets_.end()) {
+        return;
+    }
+    auto& documents = bucket->second;
+    const auto it = lower_bound(documents.begin(), documents.end(), document);
+    if (it != documents.end() && *it == document) {
+        documents.erase(it);
+    }
+    if (documents.empty()) {
+        buckets_.erase(bucket);
+    }
+}
+
+DocumentBitmap RatingIndex::Collect(int min_rating, int max_rating) const {
+    DocumentBitmap result;
+    if (min_rating > max_rating) {
+        return result;
+    }
+    const auto last = buckets_.upper_bound(max_rating);
+    for (auto bucket = buckets_.lower_bound(min_rating); bucket != last; ++bucket) {
+        for (const uint32_t document : bucket->second) {
+            result.Set(document);
+        }
+    }
+    return result;
+}
+
+MemoryUsage RatingIndex::GetMemoryUsage() const {
+    return buckets_.get_allocator().outer_allocator().GetUsage();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <scoped_allocator>
+#include <utility>
+#include <vector>
+
+#include "document_bitmap.h"
+#include "memory_accounting.h"
+
+// Вторичный индекс по среднему рейтингу: для каждого значения рейтинга
+// хранится отсортированный список внутренних идентификаторов документов
+class RatingIndex {
+public:
+    void Add(int rating, std::uint32_t document);
+    void Remove(int rating, std::uint32_t document);
+
+    // Документы с рейтингом из отрезка [min_rating, max_rating]
+    DocumentBitmap Collect(int min_rating, int max_rating) const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    using Documents = std::vector<std::uint32_t, CountingAllocator<std::uint32_t>>;
+
+    std::map<int, Documents, std::less<int>,
+             std::scoped_allocator_adaptor<CountingAllocator<std::pair<const int, Documents>>>> buckets_;
+};
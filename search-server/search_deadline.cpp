@@ -0,0 +1,39 @@
+#include "search_deadline.h"
+
+using namespace std;
+
+CancellationToken::CancellationToken()
+    : is_cancelled_(make_shared<atomic<bool>>(false)) {
+}
+
+void CancellationToken::Cancel() const {
+    is_cancelled_->store(true, memory_order_relaxed);
+}
+
+bool CancellationToken::IsCancelled() const {
+    return is_cancelled_->load(memory_order_relaxed);
+}
+
+SearchDeadline::SearchDeadline(Clock::duration budget)
+    : expiry_(Clock::now() + budget) {
+}
+
+SearchDeadline::SearchDeadline(Clock::time_point expiry)
+    : expiry_(expiry) {
+}
+
+SearchDeadline::SearchDeadline(CancellationToken token)
+    : token_(move(token)) {
+}
+
+SearchDeadline::SearchDeadline(Clock::duration budget, CancellationToken token)
+    : expiry_(Clock::now() + budget)
+    , token_(move(token)) {
+}
+
+bool SearchDeadline::IsExpired() const {
+    if (token_ && token_->IsCancelled()) {
+        return true;
+    }
+    return expiry_ != Clock::time_point::max() && Clock::now() >= expiry_;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+
+// Флаг отмены, общий для всех копий токена
+class CancellationToken {
+public:
+    CancellationToken();
+
+    void Cancel() const;
+    bool IsCancelled() const;
+
+private:
+    std::shared_ptr<std::atomic<bool>> is_cancelled_;
+};
+
+// Срок выполнения запроса: момент времени и/или токен отмены; по умолчанию не истекает
+class SearchDeadline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SearchDeadline() = default;
+    // Отсчитывается от момента создания
+    explicit SearchDeadline(Clock::duration budget);
+    explicit SearchDeadline(Clock::time_point expiry);
+    explicit SearchDeadline(CancellationToken token);
+    SearchDeadline(Clock::duration budget, CancellationToken token);
+
+    bool IsExpired() const;
+
+private:
+    Clock::time_point expiry_ = Clock::time_point::max();
+    std::optional<CancellationToken> token_;
+};
@@ -13,33 +13,224 @@ SearchServer::SearchServer(const string& stop_words_text)
 }
 
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    CheckNewDocumentId(document_id);
+    AddDocumentTerms(document_id, ComputeTermFreqs(document), status, ComputeAverageRating(ratings));
+}
+
+void SearchServer::UpdateDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    const InternalId internal_id = GetInternalId(document_id);
+    // Слова сменяются раньше статуса: изменения списков учитываются в отобранных документах прежнего статуса
+    UpdateDocumentTerms(internal_id, ComputeTermFreqs(document));
+    UpdateDocumentMetadata(internal_id, status, ComputeAverageRating(ratings));
+    InvalidateSnapshots();
+}
+
+void SearchServer::UpdateDocument(int document_id, DocumentStatus status, const vector<int>& ratings) {
+    UpdateDocumentMetadata(GetInternalId(document_id), status, ComputeAverageRating(ratings));
+}
+
+void SearchServer::CheckAddDocument(int document_id, string_view document) const {
+    CheckNewDocumentId(document_id);
+    SplitIntoWordsNoStop(document);
+}
+
+void SearchServer::CheckUpdateDocument(int document_id, string_view document) const {
+    GetInternalId(document_id);
+    SplitIntoWordsNoStop(document);
+}
+
+void SearchServer::CheckUpdateDocument(int document_id) const {
+    GetInternalId(document_id);
+}
+
+void SearchServer::CheckNewDocumentId(int document_id) const {
+    if ((document_id < 0) || (document_ids_.count(document_id) > 0)) {
         throw invalid_argument("Invalid document_id"s);
     }
+}
+
+vector<pair<TermId, double>> SearchServer::ComputeTermFreqs(string_view document) {
     const auto words = SplitIntoWordsNoStop(document);
-    const double inv_word_count = 1.0 / words.size();
+
+    vector<TermId> document_terms;
+    document_terms.reserve(words.size());
     for (const auto& word : words) {
-        auto it = word_to_document_freqs_.find(word);
-        if (it == word_to_document_freqs_.end()) {
-            it = word_to_document_freqs_.emplace(make_pair(string{word}, map<int, double>{})).first;
+        document_terms.push_back(InsertTerm(word));
+    }
+    sort(document_terms.begin(), document_terms.end());
+
+    const double inv_word_count = 1.0 / words.size();
+    vector<pair<TermId, double>> term_freqs;
+    for (const TermId term : document_terms) {
+        if (term_freqs.empty() || term_freqs.back().first != term) {
+            term_freqs.emplace_back(term, 0.0);
         }
-        it->second[document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][it->first] += inv_word_count;
+        term_freqs.back().second += inv_word_count;
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
-    document_ids_.insert(document_id);
+    return term_freqs;
+}
+
+TermId SearchServer::InsertTerm(string_view word) {
+    const TermId term = terms_.Insert(word);
+    if (term == term_postings_.size()) {
+        term_postings_.emplace_back();
+        term_document_counts_.push_back(0);
+    }
+    return term;
+}
+
+void SearchServer::AddDocumentTerms(int document_id, const vector<pair<TermId, double>>& term_freqs, DocumentStatus status, int rating) {
+    const InternalId internal_id = forward_index_.AddRow(term_freqs);
+    document_ids_.emplace(document_id, internal_id);
+    document_external_ids_.push_back(document_id);
+    document_ratings_.push_back(rating);
+    document_statuses_.push_back(status);
+    status_documents_[static_cast<size_t>(status)].Set(internal_id);
+    rating_index_.Add(document_ratings_.back(), internal_id);
+
+    for (const auto& [term, term_freq] : term_freqs) {
+        term_postings_[term].push_back({internal_id, term_freq});
+        ++term_document_counts_[term];
+        impact_index_.Add(term, internal_id, term_freq, term_postings_[term]);
+        term_top_documents_.Add(term, internal_id, term_freq, term_postings_[term], document_statuses_);
+    }
+    InvalidateSnapshots();
 }
 
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
     return FindTopDocuments(execution::seq, raw_query, status);
 }
 
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, const SearchFilter& filter) const {
+    return FindTopDocuments(execution::seq, raw_query, filter);
+}
+
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
     return FindTopDocuments(execution::seq, raw_query);
 }
 
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, QueryMode mode, DocumentStatus status) const {
+    return FindTopFilteredDocuments(raw_query, mode, MakeStatusFilter(status));
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, QueryMode mode) const {
+    return FindTopDocuments(raw_query, mode, DocumentStatus::ACTUAL);
+}
+
+TopDocuments SearchServer::FindTopDocumentsWithDeadline(string_view raw_query, const SearchDeadline& deadline, DocumentStatus status) const {
+    return FindTopDocumentsWithDeadline(ParseQuery(raw_query), deadline, MakeStatusFilter(status));
+}
+
+TopDocuments SearchServer::FindTopDocumentsWithDeadline(string_view raw_query, const SearchDeadline& deadline) const {
+    return FindTopDocumentsWithDeadline(raw_query, deadline, DocumentStatus::ACTUAL);
+}
+
+CorpusStatistics& CorpusStatistics::operator+=(const CorpusStatistics& other) {
+    if (plus_word_document_counts.size() != other.plus_word_document_counts.size()) {
+        throw invalid_argument("Corpus statistics are collected for different queries"s);
+    }
+    document_count += other.document_count;
+    for (size_t i = 0; i < plus_word_document_counts.size(); ++i) {
+        plus_word_document_counts[i] += other.plus_word_document_counts[i];
+    }
+    return *this;
+}
+
+CorpusStatistics SearchServer::GetCorpusStatistics(string_view raw_query) const {
+    return {GetDocumentCount(), CountPostings(ParseQuery(raw_query).plus_words)};
+}
+
+vector<Document> SearchServer::FindTopDocumentsWithStatistics(string_view raw_query, const CorpusStatistics& statistics, DocumentStatus status) const {
+    return FindTopFilteredDocumentsWithStatistics(raw_query, statistics, MakeStatusFilter(status));
+}
+
+vector<Document> SearchServer::FindTopDocumentsWithStatistics(string_view raw_query, const CorpusStatistics& statistics) const {
+    return FindTopDocumentsWithStatistics(raw_query, statistics, DocumentStatus::ACTUAL);
+}
+
+QueryPlan SearchServer::GetQueryPlan(string_view raw_query, DocumentStatus status) const {
+    return MakeQueryPlan(ParseQuery(raw_query), MakeStatusFilter(status), static_cast<unsigned>(ThreadPool::GetDefault().GetThreadCount()));
+}
+
+QueryPlan SearchServer::GetQueryPlan(string_view raw_query) const {
+    return GetQueryPlan(raw_query, DocumentStatus::ACTUAL);
+}
+
+SearchPage SearchServer::FindDocumentsPage(string_view raw_query, DocumentStatus status, size_t offset, size_t page_size) const {
+    return FindFilteredDocumentsPage(raw_query, MakeStatusFilter(status), SearchCursor{}, offset, page_size);
+}
+
+SearchPage SearchServer::FindDocumentsPage(string_view raw_query, size_t offset, size_t page_size) const {
+    return FindDocumentsPage(raw_query, DocumentStatus::ACTUAL, offset, page_size);
+}
+
+SearchPage SearchServer::FindDocumentsPage(string_view raw_query, DocumentStatus status, const SearchCursor& after, size_t page_size) const {
+    return FindFilteredDocumentsPage(raw_query, MakeStatusFilter(status), after, 0, page_size);
+}
+
+SearchPage SearchServer::FindDocumentsPage(string_view raw_query, const SearchCursor& after, size_t page_size) const {
+    return FindDocumentsPage(raw_query, DocumentStatus::ACTUAL, after, page_size);
+}
+
+SearchServer::BitmapFilter SearchServer::MakeStatusFilter(DocumentStatus status) const {
+    return {&status_documents_[static_cast<size_t>(status)]};
+}
+
+DocumentBitmap SearchServer::CollectDocuments(const SearchFilter& filter) const {
+    DocumentBitmap documents;
+    for (const DocumentStatus status : filter.statuses) {
+        documents |= status_documents_[static_cast<size_t>(status)];
+    }
+    if (filter.min_rating > numeric_limits<int>::min() || filter.max_rating < numeric_limits<int>::max()) {
+        documents &= rating_index_.Collect(filter.min_rating, filter.max_rating);
+    }
+    return documents;
+}
+
+bool SearchServer::IsRankedBefore(const Document& lhs, const Document& rhs) {
+    if (abs(lhs.relevance - rhs.relevance) >= TOLERANCE) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+SearchPage SearchServer::MakePage(vector<Document> documents, size_t offset, const SearchCursor& after) {
+    if (offset >= documents.size()) {
+        return {{}, after};
+    }
+    documents.erase(documents.begin(), documents.begin() + offset);
+    if (documents.empty()) {
+        return {move(documents), after};
+    }
+    const SearchCursor next{documents.back()};
+    return {move(documents), next};
+}
+
+ExplainedDocuments SearchServer::ExplainFindTopDocuments(string_view raw_query, DocumentStatus status) const {
+    return ExplainQuery(raw_query, [this, status](const Query& query, QueryProfile* profile) {
+        return FindTopStatusDocuments(execution::seq, query, status, profile);
+    });
+}
+
+void SearchServer::RankDocuments(vector<Document>& documents, QueryProfile* profile) {
+    if (!profile) {
+        RankDocuments(execution::seq, documents);
+        return;
+    }
+    const auto ranking_start = chrono::steady_clock::now();
+    RankDocuments(execution::seq, documents);
+    profile->ranking_time += chrono::steady_clock::now() - ranking_start;
+}
+
+ExplainedDocuments SearchServer::ExplainFindTopDocuments(string_view raw_query) const {
+    return ExplainFindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_ids_.size();
 }
 
 MatchedDocuments SearchServer::MatchDocument(const string_view raw_query, int document_id) const {
@@ -47,7 +238,7 @@ MatchedDocuments SearchServer::MatchDocument(const string_view raw_query, int do
 }
 
 bool SearchServer::IsStopWord(string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(string_view word) {
@@ -70,6 +261,9 @@ vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
 }
 
 int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
+    if (ratings.empty()) {
+        return 0;
+    }
     return accumulate(ratings.begin(), ratings.end(), 0) / static_cast<int>(ratings.size());
 }
 
@@ -113,17 +307,241 @@ SearchServer::Query SearchServer::ParseQuery(string_view text, bool is_unique) c
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.find(word)->second.size());
+const SearchServer::PostingList* SearchServer::FindPostings(string_view word) const {
+    const auto term = terms_.Find(word);
+    if (!term || term_document_counts_[*term] == 0) {
+        return nullptr;
+    }
+    return &term_postings_[*term];
+}
+
+size_t SearchServer::CountTermDocuments(const PostingList& postings) const {
+    return term_document_counts_[&postings - term_postings_.data()];
+}
+
+double SearchServer::ComputeInverseDocumentFreq(const PostingList& postings) const {
+    return log(GetDocumentCount() * 1.0 / CountTermDocuments(postings));
+}
+
+bool SearchServer::SeekPosting(PostingCursor& cursor, InternalId document) {
+    cursor.position = GallopingLowerBound(cursor.position, cursor.postings->end(), document,
+        [](const Posting& posting, InternalId target) {
+            return posting.document < target;
+        });
+    return cursor.position != cursor.postings->end() && cursor.position->document == document;
+}
+
+vector<SearchServer::PostingCursor> SearchServer::MakeMinusCursors(const Query& query) const {
+    vector<PostingCursor> cursors;
+    for (const auto& word : query.minus_words) {
+        if (const auto* postings = FindPostings(word)) {
+            cursors.push_back({postings, postings->begin(), 0.0, 0});
+        }
+    }
+    return cursors;
+}
+
+vector<size_t> SearchServer::CountPostings(const vector<string_view>& words) const {
+    vector<size_t> counts;
+    counts.reserve(words.size());
+    for (const auto& word : words) {
+        const auto* postings = FindPostings(word);
+        counts.push_back(postings ? CountTermDocuments(*postings) : 0);
+    }
+    return counts;
+}
+
+DocumentBitmap SearchServer::CollectPostingDocuments(const vector<string_view>& words) const {
+    DocumentBitmap documents;
+    for (const auto& word : words) {
+        if (const auto* postings = FindPostings(word)) {
+            for (const auto& posting : *postings) {
+                documents.Set(posting.document);
+            }
+        }
+    }
+    return documents;
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    if (document_to_word_freqs_.count(document_id)) {
-        return document_to_word_freqs_.at(document_id);
+vector<SearchServer::DocumentRange> SearchServer::SplitDocumentRanges(unsigned thread_count) const {
+    const size_t document_count = document_external_ids_.size();
+    const size_t range_count = clamp<size_t>(document_count / MIN_DOCUMENT_RANGE_SIZE, 1, max(thread_count, 1u) * RANGES_PER_THREAD);
+    const size_t range_size = (document_count + range_count - 1) / range_count;
+
+    vector<DocumentRange> ranges;
+    for (size_t begin = 0; begin < document_count; begin += range_size) {
+        ranges.push_back({static_cast<InternalId>(begin), static_cast<InternalId>(min(begin + range_size, document_count))});
     }
+    return ranges;
+}
 
-    static const map<string_view, double> m;
-    return m;
+double SearchServer::EstimateSelectivity(const BitmapFilter& filter) const {
+    if (document_ids_.empty()) {
+        return 1.0;
+    }
+    return static_cast<double>(filter.documents->Count()) / document_ids_.size();
+}
+
+SearchServer::InternalId SearchServer::GetInternalId(int document_id) const {
+    const auto it = document_ids_.find(document_id);
+    if (it == document_ids_.end()) {
+        throw out_of_range("Document with id "s + to_string(document_id) + " not exist"s);
+    }
+    return it->second;
+}
+
+Document SearchServer::MakeDocument(InternalId document, double relevance) const {
+    return {document_external_ids_[document], relevance, document_ratings_[document]};
+}
+
+vector<QueryTermProfile> SearchServer::ProfileQueryTerms(const vector<string_view>& words) const {
+    vector<QueryTermProfile> terms;
+    terms.reserve(words.size());
+    for (const auto& word : words) {
+        QueryTermProfile term_profile{word};
+        const auto term = terms_.Find(word);
+        if (term && term_document_counts_[*term] > 0) {
+            term_profile.word = terms_.GetWord(*term);
+            term_profile.posting_count = term_document_counts_[*term];
+            term_profile.inverse_document_freq = ComputeInverseDocumentFreq(term_postings_[*term]);
+        }
+        terms.push_back(term_profile);
+    }
+    return terms;
+}
+
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    const auto it = document_ids_.find(document_id);
+    if (it == document_ids_.end()) {
+        return {};
+    }
+    return {forward_index_.GetRow(it->second), terms_};
+}
+
+IndexMemoryReport SearchServer::GetMemoryReport() const {
+    IndexMemoryReport report;
+
+    for (const auto& postings : term_postings_) {
+        report.posting_count += postings.size();
+    }
+    report.term_count = terms_.size();
+    if (report.term_count > 0) {
+        report.average_posting_length = report.posting_count * 1.0 / report.term_count;
+    }
+
+    MemoryUsage term_postings = term_postings_.get_allocator().outer_allocator().GetUsage();
+    term_postings += term_document_counts_.get_allocator().GetUsage();
+
+    MemoryUsage documents = document_external_ids_.get_allocator().GetUsage();
+    documents += document_ratings_.get_allocator().GetUsage();
+    documents += document_statuses_.get_allocator().GetUsage();
+
+    MemoryUsage status_documents;
+    for (const auto& bitmap : status_documents_) {
+        status_documents += bitmap.GetMemoryUsage();
+    }
+
+    report.structures = {
+        {"terms"s, terms_.GetMemoryUsage()},
+        {"term_postings"s, term_postings},
+        {"forward_index"s, forward_index_.GetMemoryUsage()},
+        {"documents"s, documents},
+        {"document_ids"s, document_ids_.get_allocator().GetUsage()},
+        {"status_documents"s, status_documents},
+        {"rating_index"s, rating_index_.GetMemoryUsage()},
+        {"stop_words"s, stop_words_.GetMemoryUsage()},
+        {"quantized_impacts"s, quantized_impacts_.GetMemoryUsage()},
+        {"impact_ordered_postings"s, impact_index_.GetMemoryUsage()},
+        {"term_top_documents"s, term_top_documents_.GetMemoryUsage()},
+    };
+    return report;
+}
+
+namespace {
+
+const uint32_t SERIALIZED_INDEX_MAGIC = 0x31495353; // "SSI1"
+
+} // namespace
+
+string SearchServer::Serialize() const {
+    string output;
+    PutFixed32(output, SERIALIZED_INDEX_MAGIC);
+
+    const auto stop_words = stop_words_.GetWords();
+    PutVarint(output, stop_words.size());
+    for (const string_view word : stop_words) {
+        PutString(output, word);
+    }
+
+    // Документы в порядке внутренних идентификаторов, чтобы сохранился порядок списков документов
+    PutVarint(output, document_ids_.size());
+    for (InternalId document = 0; document < document_external_ids_.size(); ++document) {
+        if (document_external_ids_[document] == REMOVED_DOCUMENT_ID) {
+            continue;
+        }
+        PutSignedVarint(output, document_external_ids_[document]);
+        PutVarint(output, static_cast<uint64_t>(document_statuses_[document]));
+        PutSignedVarint(output, document_ratings_[document]);
+        const auto row = forward_index_.GetRow(document);
+        PutVarint(output, row.size());
+        for (size_t i = 0; i < row.size(); ++i) {
+            PutString(output, terms_.GetWord(row.GetTerm(i)));
+            PutDouble(output, row.GetFreq(i));
+        }
+    }
+    return output;
+}
+
+SearchServer SearchServer::Deserialize(string_view data) {
+    BinaryReader reader(data);
+    if (reader.ReadFixed32() != SERIALIZED_INDEX_MAGIC) {
+        throw CorruptedDataError("Not a serialized search index"s);
+    }
+
+    // Счётчики не больше числа оставшихся байтов: каждое значение занимает хотя бы байт
+    const auto read_count = [&reader, &data] {
+        const uint64_t count = reader.ReadVarint();
+        if (count > data.size()) {
+            throw CorruptedDataError("Invalid element count"s);
+        }
+        return static_cast<size_t>(count);
+    };
+
+    vector<string_view> stop_words(read_count());
+    for (auto& word : stop_words) {
+        word = reader.ReadString();
+    }
+    SearchServer server(stop_words);
+
+    const size_t document_count = read_count();
+    vector<pair<TermId, double>> term_freqs;
+    for (size_t i = 0; i < document_count; ++i) {
+        const int64_t document_id = reader.ReadSignedVarint();
+        const uint64_t status = reader.ReadVarint();
+        const int64_t rating = reader.ReadSignedVarint();
+        if (document_id < 0 || document_id > numeric_limits<int>::max() || server.document_ids_.count(static_cast<int>(document_id)) > 0
+                || status >= DOCUMENT_STATUS_COUNT
+                || rating < numeric_limits<int>::min() || rating > numeric_limits<int>::max()) {
+            throw CorruptedDataError("Invalid document"s);
+        }
+
+        term_freqs.resize(read_count());
+        for (auto& [term, term_freq] : term_freqs) {
+            term = server.InsertTerm(reader.ReadString());
+            term_freq = reader.ReadDouble();
+        }
+        sort(term_freqs.begin(), term_freqs.end());
+        if (adjacent_find(term_freqs.begin(), term_freqs.end(), [](const auto& lhs, const auto& rhs) {
+                return lhs.first == rhs.first;
+            }) != term_freqs.end()) {
+            throw CorruptedDataError("Repeated word in document"s);
+        }
+        server.AddDocumentTerms(static_cast<int>(document_id), term_freqs, static_cast<DocumentStatus>(status), static_cast<int>(rating));
+    }
+    if (!reader.empty()) {
+        throw CorruptedDataError("Unexpected data after serialized index"s);
+    }
+    return server;
 }
 
 void SearchServer::RemoveDocument(int document_id) {
@@ -131,111 +549,488 @@ void SearchServer::RemoveDocument(int document_id) {
 }
 
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy& seq, int document_id) {
-    for (const auto& [word, _] : document_to_word_freqs_[document_id]) {
-        auto it = word_to_document_freqs_.find(word);
-        if (it != word_to_document_freqs_.end()) {
-            it->second.erase(document_id);
+    const auto it = document_ids_.find(document_id);
+    if (it == document_ids_.end()) {
+        return;
+    }
+    const InternalId document = it->second;
+
+    // Записи документа остаются в списках слов: поиск отсекает его фильтром, а вычищает их уплотнение
+    const auto row = forward_index_.GetRow(document);
+    for (size_t i = 0; i < row.size(); ++i) {
+        const TermId term = row.GetTerm(i);
+        --term_document_counts_[term];
+        impact_index_.Remove(term, document, row.GetFreq(i), term_document_counts_[term]);
+        term_top_documents_.Remove(term, document, row.GetFreq(i), term_document_counts_[term], document_statuses_);
+    }
+    forward_index_.RemoveRow(document);
+    status_documents_[static_cast<size_t>(document_statuses_[document])].Reset(document);
+    rating_index_.Remove(document_ratings_[document], document);
+    document_external_ids_[document] = REMOVED_DOCUMENT_ID;
+    document_statuses_[document] = REMOVED_DOCUMENT_STATUS;
+    document_ids_.erase(it);
+
+    const size_t removed_count = document_external_ids_.size() - document_ids_.size();
+    if (removed_count > document_external_ids_.size() * MAX_REMOVED_DOCUMENT_SHARE) {
+        CompactDocuments();
+    }
+    InvalidateSnapshots();
+}
+
+void SearchServer::UpdateDocumentTerms(InternalId document, const vector<pair<TermId, double>>& term_freqs) {
+    // Строка прямого индекса и новые частоты отсортированы по слову, поэтому различия находятся слиянием
+    const auto row = forward_index_.GetRow(document);
+    size_t old_index = 0;
+    size_t new_index = 0;
+    while (old_index < row.size() || new_index < term_freqs.size()) {
+        if (new_index == term_freqs.size() || (old_index < row.size() && row.GetTerm(old_index) < term_freqs[new_index].first)) {
+            const TermId term = row.GetTerm(old_index);
+            ErasePosting(term, document);
+            impact_index_.Remove(term, document, row.GetFreq(old_index), term_document_counts_[term]);
+            term_top_documents_.Remove(term, document, row.GetFreq(old_index), term_document_counts_[term], document_statuses_);
+            ++old_index;
+        } else if (old_index == row.size() || term_freqs[new_index].first < row.GetTerm(old_index)) {
+            const auto [term, term_freq] = term_freqs[new_index];
+            SetPosting(term, document, term_freq);
+            impact_index_.Add(term, document, term_freq, term_postings_[term]);
+            term_top_documents_.Add(term, document, term_freq, term_postings_[term], document_statuses_);
+            ++new_index;
+        } else {
+            const auto [term, term_freq] = term_freqs[new_index];
+            const double old_term_freq = row.GetFreq(old_index);
+            if (term_freq != old_term_freq) {
+                SetPosting(term, document, term_freq);
+                impact_index_.Remove(term, document, old_term_freq, term_document_counts_[term]);
+                impact_index_.Add(term, document, term_freq, term_postings_[term]);
+                term_top_documents_.Update(term, document, old_term_freq, term_freq, document_statuses_);
+            }
+            ++old_index;
+            ++new_index;
+        }
+    }
+    forward_index_.ReplaceRow(document, term_freqs);
+}
+
+void SearchServer::UpdateDocumentMetadata(InternalId document, DocumentStatus status, int rating) {
+    const DocumentStatus old_status = document_statuses_[document];
+    if (status != old_status) {
+        status_documents_[static_cast<size_t>(old_status)].Reset(document);
+        status_documents_[static_cast<size_t>(status)].Set(document);
+        document_statuses_[document] = status;
+        // Отобранные документы хранятся по статусам только для частых слов, остальные слова пропускаются сразу
+        const auto row = forward_index_.GetRow(document);
+        for (size_t i = 0; i < row.size(); ++i) {
+            term_top_documents_.ChangeStatus(row.GetTerm(i), document, row.GetFreq(i), static_cast<size_t>(old_status), document_statuses_);
         }
     }
-    document_to_word_freqs_.erase(document_id);
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
+    if (rating != document_ratings_[document]) {
+        rating_index_.Remove(document_ratings_[document], document);
+        rating_index_.Add(rating, document);
+        document_ratings_[document] = rating;
+    }
 }
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy& policy, int document_id) {
-    using namespace std;
+    RemoveDocument(ThreadPool::GetDefault(), document_id);
+}
 
-    if (document_ids_.count(document_id) == 0) {
-        return;
+void SearchServer::RemoveDocument(ThreadPool&, int document_id) {
+    // Списки слов не меняются при удалении, поэтому распараллеливать нечего
+    RemoveDocument(execution::seq, document_id);
+}
+
+void SearchServer::QuantizeImpacts(ImpactPrecision precision) {
+    double max_impact = 0.0;
+    for (const auto& postings : term_postings_) {
+        if (CountTermDocuments(postings) == 0) {
+            continue;
+        }
+        const double inverse_document_freq = ComputeInverseDocumentFreq(postings);
+        for (const auto& posting : postings) {
+            if (document_external_ids_[posting.document] != REMOVED_DOCUMENT_ID) {
+                max_impact = max(max_impact, posting.term_freq * inverse_document_freq);
+            }
+        }
+    }
+
+    QuantizedImpacts impacts(precision, max_impact);
+    for (const auto& postings : term_postings_) {
+        if (CountTermDocuments(postings) > 0) {
+            const double inverse_document_freq = ComputeInverseDocumentFreq(postings);
+            for (const auto& [document, term_freq] : postings) {
+                if (document_external_ids_[document] != REMOVED_DOCUMENT_ID) {
+                    impacts.Add(document, term_freq * inverse_document_freq);
+                }
+            }
+        }
+        impacts.FinishTerm();
+    }
+    quantized_impacts_ = move(impacts);
+}
+
+const QuantizedImpacts* SearchServer::GetQuantizedImpacts() const {
+    return quantized_impacts_.empty() ? nullptr : &quantized_impacts_;
+}
+
+void SearchServer::SetImpactOrderThreshold(size_t threshold) {
+    impact_index_ = ImpactOrderedIndex(threshold);
+    for (TermId term = 0; term < term_postings_.size(); ++term) {
+        impact_index_.Build(term, term_postings_[term]);
+    }
+}
+
+DocumentReorderingReport SearchServer::ReorderDocuments() {
+    return ReorderDocuments(ThreadPool::GetDefault());
+}
+
+DocumentReorderingReport SearchServer::ReorderDocuments(ThreadPool& pool, const DocumentReorderingOptions& options) {
+    // До и после сравниваются одни и те же записи, без оставшихся от удалённых документов
+    if (document_ids_.size() < document_external_ids_.size()) {
+        CompactDocuments();
+    }
+    DocumentReorderingReport report;
+    for (const auto& postings : term_postings_) {
+        report.posting_count += postings.size();
+        report.encoded_size_before += ComputeEncodedGapSize(postings);
+    }
+
+    vector<InternalId> documents;
+    vector<vector<TermId>> document_terms;
+    documents.reserve(document_ids_.size());
+    document_terms.reserve(document_ids_.size());
+    for (const auto& [document_id, document] : document_ids_) {
+        const auto row = forward_index_.GetRow(document);
+        documents.push_back(document);
+        document_terms.emplace_back(row.size());
+        for (size_t i = 0; i < row.size(); ++i) {
+            document_terms.back()[i] = row.GetTerm(i);
+        }
+    }
+    const vector<uint32_t> order = ComputeBisectionOrder(document_terms, pool, options);
+    document_terms.clear();
+
+    vector<InternalId> ordered_documents;
+    ordered_documents.reserve(order.size());
+    for (const uint32_t index : order) {
+        ordered_documents.push_back(documents[index]);
+    }
+    RenumberDocuments(ordered_documents);
+
+    report.document_count = documents.size();
+    for (const auto& postings : term_postings_) {
+        report.encoded_size_after += ComputeEncodedGapSize(postings);
+    }
+    return report;
+}
+
+void SearchServer::RenumberDocuments(const vector<InternalId>& documents) {
+    struct DocumentData {
+        int id;
+        DocumentStatus status;
+        int rating;
+        vector<pair<TermId, double>> term_freqs;
+    };
+    vector<DocumentData> document_data;
+    document_data.reserve(documents.size());
+    for (const InternalId document : documents) {
+        const auto row = forward_index_.GetRow(document);
+        DocumentData data{document_external_ids_[document], document_statuses_[document], document_ratings_[document], {}};
+        data.term_freqs.reserve(row.size());
+        for (size_t i = 0; i < row.size(); ++i) {
+            data.term_freqs.emplace_back(row.GetTerm(i), row.GetFreq(i));
+        }
+        document_data.push_back(move(data));
+    }
+
+    // Документы добавляются заново в новом порядке; удалённые документы при этом вычищаются.
+    // Словарь сохраняется, а производные списки строятся один раз по готовым спискам документов
+    forward_index_ = ForwardIndex{};
+    document_ids_.clear();
+    document_external_ids_.clear();
+    document_ratings_.clear();
+    document_statuses_.clear();
+    status_documents_ = {};
+    rating_index_ = RatingIndex{};
+    for (auto& postings : term_postings_) {
+        postings.clear();
+    }
+    fill(term_document_counts_.begin(), term_document_counts_.end(), 0);
+    for (const DocumentData& data : document_data) {
+        const InternalId document = forward_index_.AddRow(data.term_freqs);
+        document_ids_.emplace(data.id, document);
+        document_external_ids_.push_back(data.id);
+        document_ratings_.push_back(data.rating);
+        document_statuses_.push_back(data.status);
+        status_documents_[static_cast<size_t>(data.status)].Set(document);
+        rating_index_.Add(data.rating, document);
+        for (const auto& [term, term_freq] : data.term_freqs) {
+            term_postings_[term].push_back({document, term_freq});
+            ++term_document_counts_[term];
+        }
+    }
+    document_external_ids_.shrink_to_fit();
+    document_ratings_.shrink_to_fit();
+    document_statuses_.shrink_to_fit();
+    SetImpactOrderThreshold(impact_index_.GetMinPostingCount());
+    SetTermTopDocumentsThreshold(term_top_documents_.GetMinPostingCount());
+    InvalidateSnapshots();
+}
+
+void SearchServer::CompactDocuments() {
+    vector<InternalId> documents;
+    documents.reserve(document_ids_.size());
+    for (InternalId document = 0; document < document_external_ids_.size(); ++document) {
+        if (document_external_ids_[document] != REMOVED_DOCUMENT_ID) {
+            documents.push_back(document);
+        }
+    }
+    RenumberDocuments(documents);
+}
+
+void SearchServer::SetTermTopDocumentsThreshold(size_t threshold) {
+    term_top_documents_ = TermTopDocuments(DOCUMENT_STATUS_COUNT, TERM_TOP_DOCUMENT_COUNT, threshold);
+    for (TermId term = 0; term < term_postings_.size(); ++term) {
+        term_top_documents_.Build(term, term_postings_[term], document_statuses_);
+    }
+}
+
+optional<vector<Document>> SearchServer::FindTermTopDocuments(const Query& query, DocumentStatus status) const {
+    if (query.plus_words.size() != 1) {
+        return nullopt;
+    }
+    const auto term = terms_.Find(query.plus_words.front());
+    if (!term || term_document_counts_[*term] == 0) {
+        return nullopt;
+    }
+    const auto top_list = term_top_documents_.Find(*term, static_cast<size_t>(status), term_postings_[*term], document_statuses_);
+    if (!top_list) {
+        return nullopt;
+    }
+    vector<TermId> minus_terms;
+    for (const auto& word : query.minus_words) {
+        if (const auto minus_term = terms_.Find(word)) {
+            minus_terms.push_back(*minus_term);
+        }
+    }
+
+    const double inverse_document_freq = ComputeInverseDocumentFreq(term_postings_[*term]);
+    vector<Document> matched_documents;
+    for (const auto& [document, term_freq] : *top_list->entries) {
+        const auto row = forward_index_.GetRow(document);
+        const bool is_excluded = any_of(minus_terms.begin(), minus_terms.end(), [&row](TermId minus_term) {
+            return row.Contains(minus_term);
+        });
+        if (!is_excluded) {
+            matched_documents.push_back(MakeDocument(document, term_freq * inverse_document_freq));
+        }
+    }
+    RankDocuments(execution::seq, matched_documents);
+
+    // Остальные документы статуса должны уступать всей выдаче с учётом рейтинга
+    const auto& unlisted = top_list->unlisted;
+    if (unlisted.count > 0
+            && (matched_documents.size() < MAX_RESULT_DOCUMENT_COUNT
+                || unlisted.max_term_freq * inverse_document_freq >= matched_documents.back().relevance - TOLERANCE)) {
+        return nullopt;
     }
+    return matched_documents;
+}
 
-    const auto& words_in_document = document_to_word_freqs_[document_id];
-    vector<string_view> words(words_in_document.size());
-    transform(
-            policy,
-            words_in_document.begin(), words_in_document.end(),
-            words.begin(),
-            [](const auto& p){
-                return p.first;
-            });
-    for_each(
-            policy,
-            words.begin(), words.end(),
-            [this, document_id](const auto& w) {
-                word_to_document_freqs_.find(w)->second.erase(document_id);
-            });
-    document_to_word_freqs_.erase(document_id);
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
+void SearchServer::InvalidateSnapshots() {
+    quantized_impacts_ = QuantizedImpacts{};
+}
+
+void SearchServer::SetPosting(TermId term, InternalId document, double term_freq) {
+    auto& postings = term_postings_[term];
+    const auto it = lower_bound(postings.begin(), postings.end(), document,
+        [](const Posting& posting, InternalId document) {
+            return posting.document < document;
+        });
+    if (it != postings.end() && it->document == document) {
+        it->term_freq = term_freq;
+    } else {
+        postings.insert(it, {document, term_freq});
+        ++term_document_counts_[term];
+    }
+}
+
+void SearchServer::ErasePosting(TermId term, InternalId document) {
+    auto& postings = term_postings_[term];
+    const auto it = lower_bound(postings.begin(), postings.end(), document,
+        [](const Posting& posting, InternalId document) {
+            return posting.document < document;
+        });
+    if (it != postings.end() && it->document == document) {
+        postings.erase(it);
+        --term_document_counts_[term];
+    }
 }
 
 MatchedDocuments SearchServer::MatchDocument(const std::execution::sequenced_policy& seq, std::string_view raw_query, int document_id) const {
-    using namespace std;
+    return MatchQuery(ParseQuery(raw_query), document_id, nullptr);
+}
 
+ExplainedMatch SearchServer::ExplainMatchDocument(string_view raw_query, int document_id) const {
+    using Clock = chrono::steady_clock;
+
+    QueryProfile profile;
+
+    const auto parse_start = Clock::now();
     const auto query = ParseQuery(raw_query);
+    profile.parse_time = Clock::now() - parse_start;
+    profile.plus_terms = ProfileQueryTerms(query.plus_words);
+    profile.minus_terms = ProfileQueryTerms(query.minus_words);
+
+    const auto scoring_start = Clock::now();
+    auto matched = MatchQuery(query, document_id, &profile);
+    profile.scoring_time = Clock::now() - scoring_start;
+
+    return {move(matched), move(profile)};
+}
+
+void SearchServer::MatchDocuments(string_view raw_query, const vector<int>& document_ids, vector<MatchedDocuments>& results) const {
+    ThreadPool* pool = document_ids.size() >= MATCH_PARALLEL_BATCH_SIZE ? &ThreadPool::GetDefault() : nullptr;
+    MatchDocumentBatch(pool, raw_query, document_ids, results);
+}
+
+void SearchServer::MatchDocuments(ThreadPool& pool, string_view raw_query, const vector<int>& document_ids, vector<MatchedDocuments>& results) const {
+    MatchDocumentBatch(&pool, raw_query, document_ids, results);
+}
+
+void SearchServer::MatchDocumentBatch(ThreadPool* pool, string_view raw_query, const vector<int>& document_ids,
+                                      vector<MatchedDocuments>& results) const {
+    const QueryTerms terms = ResolveQueryTerms(ParseQuery(raw_query));
+    const vector<InternalId> documents = GetInternalIds(document_ids);
+    results.resize(documents.size());
+    const auto match = [this, &terms, &documents, &results](size_t index) {
+        MatchQueryTerms(terms, documents[index], results[index]);
+    };
+    if (pool == nullptr) {
+        for (size_t index = 0; index < documents.size(); ++index) {
+            match(index);
+        }
+        return;
+    }
+    pool->ParallelFor(0, documents.size(), match);
+}
+
+SearchServer::QueryTerms SearchServer::ResolveQueryTerms(const Query& query) const {
+    QueryTerms terms;
+    for (const auto& word : query.plus_words) {
+        if (const auto term = terms_.Find(word)) {
+            terms.plus_terms.push_back(*term);
+        }
+    }
+    for (const auto& word : query.minus_words) {
+        if (const auto term = terms_.Find(word)) {
+            terms.minus_terms.push_back(*term);
+        }
+    }
+    return terms;
+}
+
+void SearchServer::MatchQueryTerms(const QueryTerms& terms, InternalId document, MatchedDocuments& result) const {
+    auto& [matched_words, status] = result;
+    matched_words.clear();
+    status = document_statuses_[document];
+    const auto row = forward_index_.GetRow(document);
+    for (const TermId term : terms.minus_terms) {
+        if (row.Contains(term)) {
+            return;
+        }
+    }
+    for (const TermId term : terms.plus_terms) {
+        if (row.Contains(term)) {
+            matched_words.push_back(terms_.GetWord(term));
+        }
+    }
+}
+
+vector<SearchServer::InternalId> SearchServer::GetInternalIds(const vector<int>& document_ids) const {
+    vector<InternalId> documents;
+    documents.reserve(document_ids.size());
+    for (const int document_id : document_ids) {
+        documents.push_back(GetInternalId(document_id));
+    }
+    return documents;
+}
+
+// В профиле MatchDocument "просмотренные" — это проверенные списки документов слов запроса,
+// а "принятые" — слова, найденные в документе
+MatchedDocuments SearchServer::MatchQuery(const Query& query, int document_id, QueryProfile* profile) const {
+    const InternalId document = GetInternalId(document_id);
+    const auto status = document_statuses_[document];
+    const auto row = forward_index_.GetRow(document);
 
     vector<string_view> matched_words;
     for (const auto& word : query.plus_words) {
-        auto it = word_to_document_freqs_.find(word);
-        if (it == word_to_document_freqs_.end()) {
+        const auto term = terms_.Find(word);
+        if (!term) {
             continue;
         }
-        if (it->second.count(document_id)) {
-            matched_words.push_back(it->first);
+        if (profile) {
+            ++profile->postings_visited;
+        }
+        if (row.Contains(*term)) {
+            matched_words.push_back(terms_.GetWord(*term));
         }
     }
 
     for (const auto& word : query.minus_words) {
-        auto it = word_to_document_freqs_.find(word);
-        if (it == word_to_document_freqs_.end()) {
+        const auto term = terms_.Find(word);
+        if (!term) {
             continue;
         }
-        if (it->second.count(document_id)) {
-            static const vector<string_view> v;
-            return {v, documents_.at(document_id).status};
+        if (profile) {
+            ++profile->postings_visited;
+        }
+        if (row.Contains(*term)) {
+            if (profile) {
+                profile->documents_removed_by_minus_words = 1;
+            }
+            return {vector<string_view>{}, status};
         }
     }
 
-
-    return {matched_words, documents_.at(document_id).status};
+    if (profile) {
+        profile->postings_accepted = matched_words.size();
+    }
+    return {matched_words, status};
 }
 
 MatchedDocuments SearchServer::MatchDocument(const std::execution::parallel_policy& policy, std::string_view raw_query, int document_id) const {
-    using namespace std;
+    return MatchDocument(ThreadPool::GetDefault(), raw_query, document_id);
+}
 
-    if (document_ids_.count(document_id) == 0) {
-        throw out_of_range("Document with id "s + to_string(document_id) + " not exist"s);
-    }
+MatchedDocuments SearchServer::MatchDocument(ThreadPool& pool, std::string_view raw_query, int document_id) const {
+    const InternalId document = GetInternalId(document_id);
+    const auto status = document_statuses_[document];
 
-    const auto& query = ParseQuery(raw_query, false);
-    const auto& words_to_freqs = document_to_word_freqs_.find(document_id)->second;
-    const auto& predicate = [&words_to_freqs](const auto& word){
-        const auto& it = words_to_freqs.find(word);
-        return it != words_to_freqs.end();
+    const auto query = ParseQuery(raw_query, false);
+    const auto row = forward_index_.GetRow(document);
+    const auto find_word = [this, &row](string_view word) {
+        const auto term = terms_.Find(word);
+        return term && row.Contains(*term) ? terms_.GetWord(*term) : ""sv;
     };
 
-    if (any_of(policy, query.minus_words.begin(), query.minus_words.end(), predicate)) {
-        static const vector<string_view> v;
-        return {v, documents_.at(document_id).status};
+    atomic<bool> has_minus_word = false;
+    pool.ParallelFor(0, query.minus_words.size(), [&query, &find_word, &has_minus_word](size_t index) {
+        if (!has_minus_word.load(memory_order_relaxed) && !find_word(query.minus_words[index]).empty()) {
+            has_minus_word.store(true, memory_order_relaxed);
+        }
+    });
+    if (has_minus_word.load()) {
+        return {vector<string_view>{}, status};
     }
 
     vector<string_view> matched_words(query.plus_words.size());
-    transform(
-        policy,
-        query.plus_words.begin(), query.plus_words.end(),
-        matched_words.begin(),
-        [&words_to_freqs](const auto& word){
-            const auto& it = words_to_freqs.find(word);
-            return it != words_to_freqs.end() ? it->first : ""sv;
+    pool.ParallelFor(0, query.plus_words.size(), [&query, &find_word, &matched_words](size_t index) {
+        matched_words[index] = find_word(query.plus_words[index]);
     });
 
-    const auto& it = remove(policy, matched_words.begin(), matched_words.end(), ""sv);
-
-    sort(policy, matched_words.begin(), it);
-    matched_words.erase(
-        unique(policy, matched_words.begin(), it),
-        matched_words.end()
-    );
+    matched_words.erase(remove(matched_words.begin(), matched_words.end(), ""sv), matched_words.end());
+    sort(matched_words.begin(), matched_words.end());
+    matched_words.erase(unique(matched_words.begin(), matched_words.end()), matched_words.end());
 
-    return {matched_words, documents_.at(document_id).status};
+    return {matched_words, status};
 }
@@ -15,10 +15,35 @@
 #include <iterator>
 #include <future>
 #include <atomic>
+#include <chrono>
+#include <utility>
+#include <scoped_allocator>
+#include <array>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <unordered_set>
 
 #include "string_processing.h"
 #include "document.h"
-#include "concurrent_map.h"
+#include "query_profile.h"
+#include "memory_accounting.h"
+#include "term_dictionary.h"
+#include "forward_index.h"
+#include "key_iterator.h"
+#include "document_bitmap.h"
+#include "rating_index.h"
+#include "galloping_search.h"
+#include "query_planner.h"
+#include "thread_pool.h"
+#include "search_deadline.h"
+#include "quantized_impacts.h"
+#include "impact_ordered_index.h"
+#include "term_top_documents.h"
+#include "stop_word_set.h"
+#include "binary_encoding.h"
+#include "document_reordering.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double TOLERANCE = 1e-6;
@@ -30,7 +55,62 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+const std::size_t DOCUMENT_STATUS_COUNT = 4;
+
+// DISJUNCTIVE — документ должен содержать хотя бы одно плюс-слово, CONJUNCTIVE — все плюс-слова
+enum class QueryMode {
+    DISJUNCTIVE,
+    CONJUNCTIVE,
+};
+
+// Декларативный фильтр документов: подходят документы с одним из статусов
+// и средним рейтингом из отрезка [min_rating, max_rating]
+struct SearchFilter {
+    std::vector<DocumentStatus> statuses = {DocumentStatus::ACTUAL};
+    int min_rating = std::numeric_limits<int>::min();
+    int max_rating = std::numeric_limits<int>::max();
+};
+
 using MatchedDocuments = std::tuple<std::vector<std::string_view>, DocumentStatus>;
+using ExplainedDocuments = std::pair<std::vector<Document>, QueryProfile>;
+using ExplainedMatch = std::pair<MatchedDocuments, QueryProfile>;
+
+// Позиция в выдаче, с которой продолжается постраничный поиск
+class SearchCursor {
+public:
+    SearchCursor() = default;
+
+private:
+    friend class SearchServer;
+
+    explicit SearchCursor(const Document& last_document)
+        : is_start_(false)
+        , last_document_(last_document) {
+    }
+
+    bool is_start_ = true;
+    Document last_document_;
+};
+
+struct SearchPage {
+    std::vector<Document> documents;
+    SearchCursor next;
+};
+
+// Число документов и документов с каждым плюс-словом запроса (в порядке разбора запроса).
+// Статистики нескольких серверов с одинаковыми стоп-словами складываются, чтобы IDF считался по всем документам
+struct CorpusStatistics {
+    int document_count = 0;
+    std::vector<std::size_t> plus_word_document_counts;
+
+    CorpusStatistics& operator+=(const CorpusStatistics& other);
+};
+
+// is_partial — поиск прерван по сроку, документы ранжированы по уже подсчитанной части запроса
+struct TopDocuments {
+    std::vector<Document> documents;
+    bool is_partial = false;
+};
 
 class SearchServer {
 public:
@@ -42,6 +122,18 @@ public:
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    // Документ сохраняет внутренний идентификатор и всё время остаётся в выдаче: меняются только записи
+    // списков документов тех слов, частота которых изменилась. Бросает out_of_range, если документа нет
+    void UpdateDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // Смена статуса и рейтинга без изменения текста не затрагивает списки документов
+    void UpdateDocument(int document_id, DocumentStatus status, const std::vector<int>& ratings);
+
+    // Бросают те же исключения, что AddDocument и UpdateDocument с этими аргументами, но сервер не меняют,
+    // например чтобы записать в журнал только выполнимое изменение
+    void CheckAddDocument(int document_id, std::string_view document) const;
+    void CheckUpdateDocument(int document_id, std::string_view document) const;
+    void CheckUpdateDocument(int document_id) const;
+
     template <typename Policy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(Policy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
 
@@ -52,41 +144,235 @@ public:
     std::vector<Document> FindTopDocuments(Policy&& policy, std::string_view raw_query, DocumentStatus status) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
 
+    // Кандидаты по фильтру собираются в битовую карту один раз на запрос
+    template <typename Policy>
+    std::vector<Document> FindTopDocuments(Policy&& policy, std::string_view raw_query, const SearchFilter& filter) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const SearchFilter& filter) const;
+
     template <typename Policy>
     std::vector<Document> FindTopDocuments(Policy&& policy, std::string_view raw_query) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+    // Вместо std::execution::par можно передать свой ThreadPool, например отдельный пул для индексации;
+    // перегрузки с par выполняются в общем пуле ThreadPool::GetDefault(). Параллельный поиск делит диапазон
+    // документов по числу потоков пула, а запросы, которым запуск задач не окупается, выполняет последовательно.
+    // Политику execution_auto можно передать в любую перегрузку FindTopDocuments:
+    // порядок слов, стратегию, обработку минус-слов и параллельность выберет планировщик.
+    // Последовательный поиск тоже планируется, но без параллельности.
+    QueryPlan GetQueryPlan(std::string_view raw_query, DocumentStatus status) const;
+    QueryPlan GetQueryPlan(std::string_view raw_query) const;
+
+    // В режиме CONJUNCTIVE списки документов слов пересекаются от самого короткого,
+    // так что стоимость запроса определяется самым редким словом
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, QueryMode mode, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, QueryMode mode, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, QueryMode mode) const;
+
+    // Срок проверяется между блоками списков документов, а слова обходятся от самого редкого,
+    // то есть от самого большого вклада в релевантность. Минус-слова применяются до подсчёта,
+    // поэтому и неполная выдача не содержит исключённых документов.
+    template <typename DocumentPredicate>
+    TopDocuments FindTopDocumentsWithDeadline(std::string_view raw_query, const SearchDeadline& deadline, DocumentPredicate document_predicate) const;
+    TopDocuments FindTopDocumentsWithDeadline(std::string_view raw_query, const SearchDeadline& deadline, DocumentStatus status) const;
+    TopDocuments FindTopDocumentsWithDeadline(std::string_view raw_query, const SearchDeadline& deadline) const;
+
+    // Те же результаты, что и у FindTopDocuments, вместе с профилем запроса:
+    // разобранные слова, длины списков документов, IDF и время каждой стадии
+    template <typename DocumentPredicate>
+    ExplainedDocuments ExplainFindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    ExplainedDocuments ExplainFindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    ExplainedDocuments ExplainFindTopDocuments(std::string_view raw_query) const;
+
+    CorpusStatistics GetCorpusStatistics(std::string_view raw_query) const;
+
+    // Релевантность считается с IDF по переданной статистике, а не по документам этого сервера.
+    // Бросает invalid_argument, если статистика собрана не для этого запроса
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsWithStatistics(std::string_view raw_query, const CorpusStatistics& statistics, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocumentsWithStatistics(std::string_view raw_query, const CorpusStatistics& statistics, DocumentStatus status) const;
+    std::vector<Document> FindTopDocumentsWithStatistics(std::string_view raw_query, const CorpusStatistics& statistics) const;
+
+    // Порядок выдачи: по убыванию релевантности, при равной с точностью TOLERANCE — по убыванию рейтинга
+    static bool IsRankedBefore(const Document& lhs, const Document& rhs);
+
+    // Страница выдачи без ограничения MAX_RESULT_DOCUMENT_COUNT. Релевантность считается для всех документов,
+    // но в ограниченной куче остаются только первые offset + page_size из них
+    template <typename DocumentPredicate>
+    SearchPage FindDocumentsPage(std::string_view raw_query, DocumentPredicate document_predicate, std::size_t offset, std::size_t page_size) const;
+    SearchPage FindDocumentsPage(std::string_view raw_query, DocumentStatus status, std::size_t offset, std::size_t page_size) const;
+    SearchPage FindDocumentsPage(std::string_view raw_query, std::size_t offset, std::size_t page_size) const;
+
+    // Следующая страница после документа, на который указывает курсор: документы до курсора
+    // отбрасываются ещё до отбора, и куча не больше page_size
+    template <typename DocumentPredicate>
+    SearchPage FindDocumentsPage(std::string_view raw_query, DocumentPredicate document_predicate, const SearchCursor& after, std::size_t page_size) const;
+    SearchPage FindDocumentsPage(std::string_view raw_query, DocumentStatus status, const SearchCursor& after, std::size_t page_size) const;
+    SearchPage FindDocumentsPage(std::string_view raw_query, const SearchCursor& after, std::size_t page_size) const;
+
     int GetDocumentCount() const;
 
     auto begin() const {
-        return document_ids_.begin();
+        return KeyIterator(document_ids_.begin());
     }
 
     auto end() const {
-        return document_ids_.end();
+        return KeyIterator(document_ids_.end());
     }
 
     MatchedDocuments MatchDocument(std::string_view raw_query, int document_id) const;
     MatchedDocuments MatchDocument(const std::execution::sequenced_policy& seq, std::string_view raw_query, int document_id) const;
     MatchedDocuments MatchDocument(const std::execution::parallel_policy& par, std::string_view raw_query, int document_id) const;
+    MatchedDocuments MatchDocument(ThreadPool& pool, std::string_view raw_query, int document_id) const;
+
+    // Совпадения запроса с каждым документом пакета, например со страницей выдачи для подсветки:
+    // запрос разбирается, а его слова ищутся в словаре один раз. results[i] — результат MatchDocument
+    // для document_ids[i]; results принадлежит вызывающему, и векторы слов переиспользуют память между вызовами.
+    // Бросает out_of_range до изменения results, если какого-то документа нет.
+    // Пакеты от MATCH_PARALLEL_BATCH_SIZE документов обрабатываются в общем пуле ThreadPool::GetDefault()
+    void MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids, std::vector<MatchedDocuments>& results) const;
+    void MatchDocuments(ThreadPool& pool, std::string_view raw_query, const std::vector<int>& document_ids, std::vector<MatchedDocuments>& results) const;
+
+    static constexpr std::size_t MATCH_PARALLEL_BATCH_SIZE = 64;
+
+    ExplainedMatch ExplainMatchDocument(std::string_view raw_query, int document_id) const;
+
+    // Представление действительно до следующего изменения сервера
+    WordFrequencies GetWordFrequencies(int document_id) const;
+
+    IndexMemoryReport GetMemoryReport() const;
+
+    // Строит снимок квантованных вкладов tf×idf для поиска с политикой execution_quantized.
+    // Изменение слов документов сбрасывает снимок, и до следующего вызова такой поиск выполняется точно;
+    // смена только статуса или рейтинга снимок сохраняет.
+    // Релевантность документа отличается от точной не больше чем на GetMaxError() снимка на слово запроса.
+    void QuantizeImpacts(ImpactPrecision precision);
+    // nullptr, если снимка нет
+    const QuantizedImpacts* GetQuantizedImpacts() const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Для слов, встречающихся хотя бы в threshold документах, поддерживается копия списка документов
+    // в порядке убывания вклада. Запросы из одного-двух таких слов читают её с начала и останавливаются,
+    // как только непрочитанные документы уже не могут попасть в выдачу.
+    // Изменения документов копятся и сливаются с копией слова при следующем поиске по нему.
+    // По умолчанию копии не поддерживаются; threshold 0 снова их отключает и освобождает память.
+    void SetImpactOrderThreshold(std::size_t threshold);
 
+    // Для слов, встречающихся хотя бы в threshold документах, поддерживаются лучшие документы каждого статуса.
+    // Однословный запрос по статусу читает только их; запросы с предикатом считаются полностью.
+    // По умолчанию списки не поддерживаются; threshold 0 снова их отключает и освобождает память.
+    void SetTermTopDocumentsThreshold(std::size_t threshold);
+
+    // Перенумеровывает внутренние идентификаторы так, чтобы документы с похожими словами шли подряд
+    // (ComputeBisectionOrder): разности в списках документов становятся меньше, а обращения к ним — локальнее.
+    // Внешние идентификаторы и выдача не меняются, снимок QuantizeImpacts сбрасывается.
+    // Отчёт сравнивает размер сжатых списков до и после перенумерации
+    DocumentReorderingReport ReorderDocuments(ThreadPool& pool, const DocumentReorderingOptions& options = {});
+    DocumentReorderingReport ReorderDocuments();
+
+    // Стоп-слова и документы в двоичном виде, например для контрольной точки журнала.
+    // Пороги SetImpactOrderThreshold и SetTermTopDocumentsThreshold и снимок QuantizeImpacts не сохраняются.
+    // Восстановленный сервер находит те же документы с той же релевантностью.
+    std::string Serialize() const;
+    // Бросает CorruptedDataError, если данные повреждены
+    static SearchServer Deserialize(std::string_view data);
+
+    // Записи удалённого документа остаются в списках слов до уплотнения, которое запускается,
+    // когда удалённых документов становится больше MAX_REMOVED_DOCUMENT_SHARE от всех внутренних идентификаторов.
+    // Уплотнение перенумеровывает документы подряд и сбрасывает снимок QuantizeImpacts
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy& seq, int document_id);
     void RemoveDocument(const std::execution::parallel_policy& par, int document_id);
+    void RemoveDocument(ThreadPool& pool, int document_id);
 
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
+    // Внутренние идентификаторы документов плотные и выдаются по порядку добавления,
+    // они же номера строк прямого индекса. Внешние идентификаторы видны только в API.
+    using InternalId = ForwardIndex::RowId;
+
+    static constexpr int REMOVED_DOCUMENT_ID = -1;
+    // Статус вне диапазона, чтобы удалённые документы не попадали в отобранные документы слов
+    static constexpr DocumentStatus REMOVED_DOCUMENT_STATUS = static_cast<DocumentStatus>(DOCUMENT_STATUS_COUNT);
+    static constexpr double MAX_REMOVED_DOCUMENT_SHARE = 0.25;
+
+    struct Posting {
+        InternalId document;
+        double term_freq;
+    };
+
+    template <typename T>
+    using Vector = std::vector<T, CountingAllocator<T>>;
+    template <typename T>
+    using NestedAllocator = std::scoped_allocator_adaptor<CountingAllocator<T>>;
+
+    // Отсортирован по внутреннему идентификатору документа; записи удалённых документов остаются до уплотнения
+    using PostingList = Vector<Posting>;
+
+    const StopWordSet stop_words_;
+    TermDictionary terms_;
+    std::vector<PostingList, NestedAllocator<PostingList>> term_postings_;
+    // Число неудалённых документов в списке слова, по нему считается IDF
+    Vector<std::size_t> term_document_counts_;
+    ForwardIndex forward_index_;
+    std::map<int, InternalId, std::less<int>, CountingAllocator<std::pair<const int, InternalId>>> document_ids_;
+
+    // Данные документов по внутреннему идентификатору; у удалённых внешний идентификатор REMOVED_DOCUMENT_ID
+    // и статус REMOVED_DOCUMENT_STATUS
+    Vector<int> document_external_ids_;
+    Vector<int> document_ratings_;
+    Vector<DocumentStatus> document_statuses_;
+    std::array<DocumentBitmap, DOCUMENT_STATUS_COUNT> status_documents_;
+    RatingIndex rating_index_;
+    ImpactOrderedIndex impact_index_;
+    // Запас сверх MAX_RESULT_DOCUMENT_COUNT, чтобы выдачу не приходилось пересчитывать после удалений
+    static constexpr std::size_t TERM_TOP_DOCUMENT_COUNT = 2 * MAX_RESULT_DOCUMENT_COUNT;
+    TermTopDocuments term_top_documents_{DOCUMENT_STATUS_COUNT, TERM_TOP_DOCUMENT_COUNT};
+
+    // Производные структуры, которые не поддерживаются при изменениях, а сбрасываются
+    QuantizedImpacts quantized_impacts_;
+
+    void InvalidateSnapshots();
+
+    TermId InsertTerm(std::string_view word);
+
+    // Частоты слов документа, отсортированные по идентификатору слова; новые слова добавляются в словарь
+    std::vector<std::pair<TermId, double>> ComputeTermFreqs(std::string_view document);
+
+    // Частоты отсортированы по идентификатору слова
+    void AddDocumentTerms(int document_id, const std::vector<std::pair<TermId, double>>& term_freqs, DocumentStatus status, int rating);
+
+    // Фильтры документов по внутреннему идентификатору для поиска
+    template <typename DocumentPredicate>
+    struct PredicateFilter {
+        const SearchServer* server;
+        DocumentPredicate document_predicate;
+
+        bool operator()(InternalId document) const {
+            return server->document_external_ids_[document] != REMOVED_DOCUMENT_ID
+                && document_predicate(server->document_external_ids_[document],
+                                      server->document_statuses_[document],
+                                      server->document_ratings_[document]);
+        }
+    };
+
+    // Проверка бита вместо вызова предиката для запросов по статусу и декларативных фильтров.
+    // Удалённые документы сняты со всех битовых карт
+    struct BitmapFilter {
+        const DocumentBitmap* documents;
+
+        bool operator()(InternalId document) const {
+            return documents->Test(document);
+        }
     };
 
-    const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string, std::map<int, double>, std::less<>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+    template <typename DocumentPredicate>
+    PredicateFilter<DocumentPredicate> MakePredicateFilter(DocumentPredicate document_predicate) const;
+
+    BitmapFilter MakeStatusFilter(DocumentStatus status) const;
+
+    DocumentBitmap CollectDocuments(const SearchFilter& filter) const;
+
+    template <typename StringContainer>
+    static StopWordSet MakeStopWords(const StringContainer& stop_words);
 
     bool IsStopWord(std::string_view word) const;
 
@@ -111,35 +397,355 @@ private:
 
     Query ParseQuery(std::string_view text, bool is_unique = true) const;
 
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    // nullptr, если слова нет или все его документы удалены
+    const PostingList* FindPostings(std::string_view word) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy& seq, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    // postings — список из term_postings_
+    std::size_t CountTermDocuments(const PostingList& postings) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& par, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    double ComputeInverseDocumentFreq(const PostingList& postings) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    InternalId GetInternalId(int document_id) const;
+
+    void CheckNewDocumentId(int document_id) const;
+
+    Document MakeDocument(InternalId document, double relevance) const;
+
+    void ErasePosting(TermId term, InternalId document);
+    // Добавляет запись документа в список слова или меняет её частоту
+    void SetPosting(TermId term, InternalId document, double term_freq);
+
+    void UpdateDocumentTerms(InternalId document, const std::vector<std::pair<TermId, double>>& term_freqs);
+    void UpdateDocumentMetadata(InternalId document, DocumentStatus status, int rating);
+
+    // Строит все структуры заново по строкам прямого индекса: documents — неудалённые документы в новом порядке
+    void RenumberDocuments(const std::vector<InternalId>& documents);
+
+    // Убирает записи удалённых документов и освобождает их идентификаторы, сохраняя порядок остальных
+    void CompactDocuments();
+
+    std::vector<QueryTermProfile> ProfileQueryTerms(const std::vector<std::string_view>& words) const;
+
+    MatchedDocuments MatchQuery(const Query& query, int document_id, QueryProfile* profile) const;
+
+    // Слова запроса, найденные в словаре; плюс-слова в порядке разбора запроса
+    struct QueryTerms {
+        std::vector<TermId> plus_terms;
+        std::vector<TermId> minus_terms;
+    };
+
+    QueryTerms ResolveQueryTerms(const Query& query) const;
+
+    void MatchQueryTerms(const QueryTerms& terms, InternalId document, MatchedDocuments& result) const;
+
+    // Общая часть публичных MatchDocuments; pool == nullptr — документы сверяются в вызывающем потоке
+    void MatchDocumentBatch(ThreadPool* pool, std::string_view raw_query, const std::vector<int>& document_ids,
+                            std::vector<MatchedDocuments>& results) const;
+
+    std::vector<InternalId> GetInternalIds(const std::vector<int>& document_ids) const;
+
+    // Позиция в списке документов слова при слиянии и пересечении списков
+    struct PostingCursor {
+        const PostingList* postings;
+        PostingList::const_iterator position;
+        double inverse_document_freq;
+        std::size_t word_index;
+    };
+
+    // Сдвигает курсор к документу; false, если документа в списке нет
+    static bool SeekPosting(PostingCursor& cursor, InternalId document);
+
+    std::vector<PostingCursor> MakeMinusCursors(const Query& query) const;
+
+    std::vector<std::size_t> CountPostings(const std::vector<std::string_view>& words) const;
+
+    DocumentBitmap CollectPostingDocuments(const std::vector<std::string_view>& words) const;
+
+    double EstimateSelectivity(const BitmapFilter& filter) const;
+
+    template <typename DocumentFilter>
+    double EstimateSelectivity(const DocumentFilter& document_filter) const;
+
+    template <typename DocumentFilter>
+    QueryPlan MakeQueryPlan(const Query& query, const DocumentFilter& document_filter, unsigned thread_count) const;
+
+    // pool — пул для обхода по диапазонам документов, если планировщик сочтёт, что запуск задач окупится;
+    // nullptr — только последовательные планы. Параллельный план оставляет лучшие count документов каждого диапазона
+    template <typename DocumentFilter>
+    std::vector<Document> FindPlannedDocuments(const Query& query, DocumentFilter document_filter, ThreadPool* pool,
+                                               std::size_t count, QueryProfile* profile = nullptr) const;
+
+    template <typename Policy>
+    static void RankDocuments(Policy&& policy, std::vector<Document>& documents, std::size_t count = MAX_RESULT_DOCUMENT_COUNT);
+
+    // Последовательная сортировка выдачи; время записывается в профиль, если он задан
+    static void RankDocuments(std::vector<Document>& documents, QueryProfile* profile);
+
+    template <typename DocumentFilter>
+    SearchPage FindFilteredDocumentsPage(std::string_view raw_query, DocumentFilter document_filter, const SearchCursor& after,
+                                         std::size_t offset, std::size_t page_size) const;
+
+    // documents — упорядоченные первые offset + page_size документов после after
+    static SearchPage MakePage(std::vector<Document> documents, std::size_t offset, const SearchCursor& after);
+
+    template <typename Policy, typename DocumentFilter>
+    std::vector<Document> FindTopFilteredDocuments(Policy&& policy, std::string_view raw_query, DocumentFilter document_filter) const;
+
+    // Выбор способа поиска; profile, если задан, получает выбранный способ и счётчики его стадий
+    template <typename Policy, typename DocumentFilter>
+    std::vector<Document> FindTopFilteredDocuments(Policy&& policy, const Query& query, DocumentFilter document_filter,
+                                                   QueryProfile* profile = nullptr) const;
+
+    template <typename Policy>
+    std::vector<Document> FindTopStatusDocuments(Policy&& policy, const Query& query, DocumentStatus status,
+                                                 QueryProfile* profile = nullptr) const;
+
+    // Выдача однословного запроса по отобранным документам слова; nullopt, если она может отличаться от полного подсчёта
+    std::optional<std::vector<Document>> FindTermTopDocuments(const Query& query, DocumentStatus status) const;
+
+    // search(query, profile) — поиск той же веткой, что и у FindTopDocuments
+    template <typename QuerySearch>
+    ExplainedDocuments ExplainQuery(std::string_view raw_query, QuerySearch search) const;
+
+    template <typename DocumentFilter>
+    ExplainedDocuments ExplainFilteredDocuments(std::string_view raw_query, DocumentFilter document_filter) const;
+
+    // inverse_document_freqs — IDF плюс-слов вместо вычисленных по этому серверу
+    template <typename DocumentFilter>
+    std::vector<Document> FindAllDocuments(const Query& query, DocumentFilter document_filter, QueryProfile* profile,
+                                           const std::vector<double>* inverse_document_freqs = nullptr) const;
+
+    // Подсчёт по словам запроса, общий для FindAllDocuments и страниц выдачи:
+    // collect(document, relevance) вызывается для каждого найденного документа
+    template <typename DocumentFilter, typename DocumentCollector>
+    void ScoreDocuments(const Query& query, DocumentFilter document_filter, DocumentCollector collect, QueryProfile* profile,
+                        const std::vector<double>* inverse_document_freqs) const;
+
+    template <typename DocumentFilter>
+    std::vector<Document> FindTopFilteredDocumentsWithStatistics(std::string_view raw_query, const CorpusStatistics& statistics, DocumentFilter document_filter) const;
+
+    template <typename DocumentFilter>
+    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy& seq, std::string_view raw_query, DocumentFilter document_filter) const;
+
+    template <typename DocumentFilter>
+    std::vector<Document> FindAllDocumentsByDocument(const Query& query, DocumentFilter document_filter, QueryProfile* profile = nullptr) const;
+
+    template <typename DocumentFilter>
+    std::vector<Document> FindAllQuantizedDocuments(const Query& query, DocumentFilter document_filter) const;
+
+    static constexpr std::size_t MAX_IMPACT_QUERY_WORDS = 2;
+    // Число записей, которое читается из каждой копии между проверками порога
+    static constexpr std::size_t IMPACT_BLOCK_SIZE = 64;
+
+    // Алгоритм порога Фейгина по копиям списков в порядке убывания вклада: непрочитанный документ
+    // набирает не больше суммы вкладов текущих позиций курсоров. nullopt, если у запроса нет копий всех слов
+    template <typename DocumentFilter>
+    std::optional<std::vector<Document>> FindTopDocumentsByImpact(const Query& query, DocumentFilter document_filter) const;
+
+    // Число записей списка документов между проверками срока
+    static constexpr std::size_t DEADLINE_CHECK_BLOCK_SIZE = 1024;
+
+    template <typename DocumentFilter>
+    TopDocuments FindTopDocumentsWithDeadline(const Query& query, const SearchDeadline& deadline, DocumentFilter document_filter) const;
+
+    // Диапазон внутренних идентификаторов [begin, end), который параллельный поиск обрабатывает целиком в одной задаче
+    struct DocumentRange {
+        InternalId begin;
+        InternalId end;
+    };
+
+    static constexpr std::size_t RANGES_PER_THREAD = 4;
+    static constexpr std::size_t MIN_DOCUMENT_RANGE_SIZE = 1024;
+
+    std::vector<DocumentRange> SplitDocumentRanges(unsigned thread_count) const;
+
+    // Каждая задача считает все слова запроса по своему диапазону документов
+    // и оставляет лучшие count документов; результаты задач только сливаются
+    template <typename DocumentFilter>
+    std::vector<Document> FindAllDocumentsByRange(const Query& query, DocumentFilter document_filter, std::size_t count, ThreadPool& pool) const;
+
+    template <typename DocumentFilter>
+    std::vector<Document> FindRangeDocuments(const std::vector<PostingCursor>& plus_cursors, const std::vector<PostingCursor>& minus_cursors,
+                                             const DocumentFilter& document_filter, DocumentRange range, std::size_t count) const;
+
+    template <typename DocumentFilter>
+    std::vector<Document> FindAllDocuments(std::string_view raw_query, DocumentFilter document_filter) const;
+
+    template <typename DocumentFilter>
+    std::vector<Document> FindTopFilteredDocuments(std::string_view raw_query, QueryMode mode, DocumentFilter document_filter) const;
+
+    template <typename DocumentFilter>
+    std::vector<Document> FindAllConjunctiveDocuments(const Query& query, DocumentFilter document_filter) const;
 };
 
 template <typename Policy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(Policy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindTopFilteredDocuments(policy, raw_query, MakePredicateFilter(document_predicate));
+}
+
+template <typename Policy, typename DocumentFilter>
+std::vector<Document> SearchServer::FindTopFilteredDocuments(Policy&& policy, std::string_view raw_query, DocumentFilter document_filter) const {
+    return FindTopFilteredDocuments(policy, ParseQuery(raw_query), document_filter);
+}
+
+template <typename Policy, typename DocumentFilter>
+std::vector<Document> SearchServer::FindTopFilteredDocuments(Policy&& policy, const Query& query, DocumentFilter document_filter,
+                                                             QueryProfile* profile) const {
     using namespace std;
 
-    vector<Document> matched_documents = FindAllDocuments(policy, raw_query, document_predicate);
+    if constexpr (is_same_v<decay_t<Policy>, execution::parallel_policy>) {
+        return FindTopFilteredDocuments(ThreadPool::GetDefault(), query, document_filter, profile);
+    } else if constexpr (is_same_v<decay_t<Policy>, QuantizedExecutionPolicy>) {
+        if (quantized_impacts_.empty()) {
+            return FindTopFilteredDocuments(execution::seq, query, document_filter, profile);
+        }
+        if (profile) {
+            profile->execution = QueryExecution::QUANTIZED;
+        }
+        vector<Document> matched_documents = FindAllQuantizedDocuments(query, document_filter);
+        RankDocuments(matched_documents, profile);
+        return matched_documents;
+    } else {
+        if (auto impact_documents = FindTopDocumentsByImpact(query, document_filter)) {
+            if (profile) {
+                profile->execution = QueryExecution::IMPACT_ORDERED;
+            }
+            return move(*impact_documents);
+        }
+        // Диапазоны документов делятся по потокам пула, а небольшой запрос, которому
+        // запуск задач обойдётся дороже подсчёта, выполняется последовательно
+        ThreadPool* pool = nullptr;
+        if constexpr (is_same_v<decay_t<Policy>, ThreadPool>) {
+            pool = &policy;
+        } else if constexpr (is_same_v<decay_t<Policy>, AutoExecutionPolicy>) {
+            pool = &ThreadPool::GetDefault();
+        }
+        vector<Document> matched_documents = FindPlannedDocuments(query, document_filter, pool, MAX_RESULT_DOCUMENT_COUNT, profile);
+        // Выдача после фильтрации невелика, параллельная сортировка не окупается
+        RankDocuments(matched_documents, profile);
+        return matched_documents;
+    }
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopStatusDocuments(Policy&& policy, const Query& query, DocumentStatus status,
+                                                           QueryProfile* profile) const {
+    if (auto documents = FindTermTopDocuments(query, status)) {
+        if (profile) {
+            profile->execution = QueryExecution::TERM_TOP_DOCUMENTS;
+        }
+        return std::move(*documents);
+    }
+    return FindTopFilteredDocuments(policy, query, MakeStatusFilter(status), profile);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, QueryMode mode, DocumentPredicate document_predicate) const {
+    return FindTopFilteredDocuments(raw_query, mode, MakePredicateFilter(document_predicate));
+}
 
-    sort(policy, matched_documents.begin(), matched_documents.end(),
-         [](const Document& lhs, const Document& rhs) {
-             return lhs.relevance > rhs.relevance
-                 || (abs(lhs.relevance - rhs.relevance) < TOLERANCE && lhs.rating > rhs.rating);
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindTopFilteredDocuments(std::string_view raw_query, QueryMode mode, DocumentFilter document_filter) const {
+    using namespace std;
+
+    if (mode == QueryMode::DISJUNCTIVE) {
+        return FindTopFilteredDocuments(execution::seq, raw_query, document_filter);
     }
+    vector<Document> matched_documents = FindAllConjunctiveDocuments(ParseQuery(raw_query), document_filter);
+    RankDocuments(execution::seq, matched_documents);
     return matched_documents;
 }
 
+template <typename DocumentPredicate>
+SearchServer::PredicateFilter<DocumentPredicate> SearchServer::MakePredicateFilter(DocumentPredicate document_predicate) const {
+    return {this, document_predicate};
+}
+
+template <typename Policy>
+void SearchServer::RankDocuments(Policy&& policy, std::vector<Document>& documents, std::size_t count) {
+    using namespace std;
+
+    if (documents.size() > count) {
+        partial_sort(policy, documents.begin(), documents.begin() + count, documents.end(), IsRankedBefore);
+        documents.resize(count);
+    } else {
+        sort(policy, documents.begin(), documents.end(), IsRankedBefore);
+    }
+}
+
+template <typename DocumentPredicate>
+SearchPage SearchServer::FindDocumentsPage(std::string_view raw_query, DocumentPredicate document_predicate, std::size_t offset, std::size_t page_size) const {
+    return FindFilteredDocumentsPage(raw_query, MakePredicateFilter(document_predicate), SearchCursor{}, offset, page_size);
+}
+
+template <typename DocumentPredicate>
+SearchPage SearchServer::FindDocumentsPage(std::string_view raw_query, DocumentPredicate document_predicate, const SearchCursor& after, std::size_t page_size) const {
+    return FindFilteredDocumentsPage(raw_query, MakePredicateFilter(document_predicate), after, 0, page_size);
+}
+
+template <typename DocumentFilter>
+SearchPage SearchServer::FindFilteredDocumentsPage(std::string_view raw_query, DocumentFilter document_filter, const SearchCursor& after,
+                                                   std::size_t offset, std::size_t page_size) const {
+    using namespace std;
+
+    const size_t count = offset + min(page_size, numeric_limits<size_t>::max() - offset);
+    // На вершине кучи худший из отобранных документов
+    vector<Document> top_documents;
+    ScoreDocuments(ParseQuery(raw_query), document_filter, [this, &after, count, &top_documents](InternalId document, double relevance) {
+        const Document candidate = MakeDocument(document, relevance);
+        if (!after.is_start_ && !IsRankedBefore(after.last_document_, candidate)) {
+            return;
+        }
+        if (top_documents.size() < count) {
+            top_documents.push_back(candidate);
+            push_heap(top_documents.begin(), top_documents.end(), IsRankedBefore);
+        } else if (count > 0 && IsRankedBefore(candidate, top_documents.front())) {
+            pop_heap(top_documents.begin(), top_documents.end(), IsRankedBefore);
+            top_documents.back() = candidate;
+            push_heap(top_documents.begin(), top_documents.end(), IsRankedBefore);
+        }
+    }, nullptr, nullptr);
+    sort_heap(top_documents.begin(), top_documents.end(), IsRankedBefore);
+    return MakePage(move(top_documents), offset, after);
+}
+
+template <typename DocumentPredicate>
+ExplainedDocuments SearchServer::ExplainFindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return ExplainFilteredDocuments(raw_query, MakePredicateFilter(document_predicate));
+}
+
+template <typename QuerySearch>
+ExplainedDocuments SearchServer::ExplainQuery(std::string_view raw_query, QuerySearch search) const {
+    using namespace std;
+    using Clock = chrono::steady_clock;
+
+    QueryProfile profile;
+
+    const auto parse_start = Clock::now();
+    const auto query = ParseQuery(raw_query);
+    profile.parse_time = Clock::now() - parse_start;
+    profile.plus_terms = ProfileQueryTerms(query.plus_words);
+    profile.minus_terms = ProfileQueryTerms(query.minus_words);
+
+    const auto search_start = Clock::now();
+    vector<Document> matched_documents = search(query, &profile);
+    const auto search_time = chrono::duration_cast<QueryProfile::Duration>(Clock::now() - search_start);
+
+    // Способы без собственной разметки стадий целиком относятся к подсчёту
+    const auto staged_time = profile.scoring_time + profile.minus_words_time + profile.ranking_time;
+    if (search_time > staged_time) {
+        profile.scoring_time += search_time - staged_time;
+    }
+    return {move(matched_documents), move(profile)};
+}
+
+template <typename DocumentFilter>
+ExplainedDocuments SearchServer::ExplainFilteredDocuments(std::string_view raw_query, DocumentFilter document_filter) const {
+    return ExplainQuery(raw_query, [this, &document_filter](const Query& query, QueryProfile* profile) {
+        return FindTopFilteredDocuments(std::execution::seq, query, document_filter, profile);
+    });
+}
+
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
     return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
@@ -147,10 +753,13 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
 
 template<typename Policy>
 std::vector<Document> SearchServer::FindTopDocuments(Policy&& policy, std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query,
-        [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+    return FindTopStatusDocuments(policy, ParseQuery(raw_query), status);
+}
+
+template<typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(Policy&& policy, std::string_view raw_query, const SearchFilter& filter) const {
+    const DocumentBitmap documents = CollectDocuments(filter);
+    return FindTopFilteredDocuments(policy, raw_query, BitmapFilter{&documents});
 }
 
 template<typename Policy>
@@ -158,96 +767,552 @@ std::vector<Document> SearchServer::FindTopDocuments(Policy&& policy, std::strin
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq, raw_query, document_predicate);
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindAllDocuments(std::string_view raw_query, DocumentFilter document_filter) const {
+    return FindAllDocuments(std::execution::seq, raw_query, document_filter);
+}
+
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy& seq, std::string_view raw_query, DocumentFilter document_filter) const {
+    return FindPlannedDocuments(ParseQuery(raw_query), document_filter, nullptr, std::numeric_limits<std::size_t>::max());
+}
+
+template <typename DocumentFilter>
+double SearchServer::EstimateSelectivity(const DocumentFilter& document_filter) const {
+    return 1.0;
+}
+
+template <typename DocumentFilter>
+QueryPlan SearchServer::MakeQueryPlan(const Query& query, const DocumentFilter& document_filter, unsigned thread_count) const {
+    QueryStatistics statistics;
+    statistics.plus_posting_counts = CountPostings(query.plus_words);
+    statistics.minus_posting_counts = CountPostings(query.minus_words);
+    statistics.document_count = document_external_ids_.size();
+    statistics.filter_selectivity = EstimateSelectivity(document_filter);
+    statistics.thread_count = thread_count;
+    return PlanQuery(statistics);
+}
+
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindPlannedDocuments(const Query& query, DocumentFilter document_filter, ThreadPool* pool,
+                                                         std::size_t count, QueryProfile* profile) const {
+    using namespace std;
+
+    const QueryPlan plan = MakeQueryPlan(query, document_filter, pool ? static_cast<unsigned>(pool->GetThreadCount()) : 1);
+    if (plan.strategy == QueryStrategy::DOCUMENT_AT_A_TIME) {
+        if (profile) {
+            profile->execution = QueryExecution::DOCUMENT_AT_A_TIME;
+        }
+        return FindAllDocumentsByDocument(query, document_filter, profile);
+    }
+
+    if (profile) {
+        profile->execution = plan.is_parallel ? QueryExecution::DOCUMENT_RANGES : QueryExecution::TERM_AT_A_TIME;
+    }
+    Query planned_query;
+    planned_query.plus_words = query.plus_words;
+    const auto find_term_at_a_time = [this, &plan, &planned_query, pool, count, profile](auto filter) {
+        if (plan.is_parallel) {
+            return FindAllDocumentsByRange(planned_query, filter, count, *pool);
+        }
+        return FindAllDocuments(planned_query, filter, profile);
+    };
+
+    if (!plan.prefilter_minus_words) {
+        planned_query.minus_words = query.minus_words;
+        return find_term_at_a_time(document_filter);
+    }
+    const DocumentBitmap excluded = CollectPostingDocuments(query.minus_words);
+    return find_term_at_a_time([&excluded, &document_filter](InternalId document) {
+        return !excluded.Test(document) && document_filter(document);
+    });
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy& seq, std::string_view raw_query, DocumentPredicate document_predicate) const {
+std::vector<Document> SearchServer::FindTopDocumentsWithStatistics(std::string_view raw_query, const CorpusStatistics& statistics, DocumentPredicate document_predicate) const {
+    return FindTopFilteredDocumentsWithStatistics(raw_query, statistics, MakePredicateFilter(document_predicate));
+}
+
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindTopFilteredDocumentsWithStatistics(std::string_view raw_query, const CorpusStatistics& statistics, DocumentFilter document_filter) const {
+    using namespace std;
+
+    const Query query = ParseQuery(raw_query);
+    if (statistics.plus_word_document_counts.size() != query.plus_words.size()) {
+        throw invalid_argument("Corpus statistics do not match the query"s);
+    }
+    vector<double> inverse_document_freqs;
+    inverse_document_freqs.reserve(query.plus_words.size());
+    for (const size_t document_count : statistics.plus_word_document_counts) {
+        // Слова без документов не встречаются и на этом сервере, их IDF не используется
+        inverse_document_freqs.push_back(document_count > 0 ? log(statistics.document_count * 1.0 / document_count) : 0.0);
+    }
+    vector<Document> matched_documents = FindAllDocuments(query, document_filter, nullptr, &inverse_document_freqs);
+    RankDocuments(execution::seq, matched_documents);
+    return matched_documents;
+}
+
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentFilter document_filter, QueryProfile* profile,
+                                                     const std::vector<double>* inverse_document_freqs) const {
+    std::vector<Document> matched_documents;
+    ScoreDocuments(query, document_filter, [this, &matched_documents](InternalId document, double relevance) {
+        matched_documents.push_back(MakeDocument(document, relevance));
+    }, profile, inverse_document_freqs);
+    return matched_documents;
+}
+
+template <typename DocumentFilter, typename DocumentCollector>
+void SearchServer::ScoreDocuments(const Query& query, DocumentFilter document_filter, DocumentCollector collect, QueryProfile* profile,
+                                  const std::vector<double>* inverse_document_freqs) const {
     using namespace std;
+    using Clock = chrono::steady_clock;
 
-    auto query = ParseQuery(raw_query);
+    auto stage_start = profile ? Clock::now() : Clock::time_point{};
+    const auto finish_stage = [&stage_start](QueryProfile::Duration& stage_time) {
+        const auto now = Clock::now();
+        stage_time += now - stage_start;
+        stage_start = now;
+    };
 
-    map<int, double> document_to_relevance;
-    for (const auto& word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    size_t postings_visited = 0;
+    size_t postings_accepted = 0;
+    vector<double> document_to_relevance(document_external_ids_.size());
+    vector<bool> is_matched(document_external_ids_.size());
+    vector<InternalId> matched;
+    for (size_t word_index = 0; word_index < query.plus_words.size(); ++word_index) {
+        const auto* postings = FindPostings(query.plus_words[word_index]);
+        if (!postings) {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.find(word)->second) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        const double inverse_document_freq = inverse_document_freqs ? (*inverse_document_freqs)[word_index] : ComputeInverseDocumentFreq(*postings);
+        postings_visited += postings->size();
+        for (const auto& [document, term_freq] : *postings) {
+            if (document_filter(document)) {
+                ++postings_accepted;
+                if (!is_matched[document]) {
+                    is_matched[document] = true;
+                    matched.push_back(document);
+                }
+                document_to_relevance[document] += term_freq * inverse_document_freq;
             }
         }
     }
+    if (profile) {
+        profile->postings_visited += postings_visited;
+        profile->postings_accepted += postings_accepted;
+        finish_stage(profile->scoring_time);
+    }
+
+    size_t documents_removed = 0;
     for (const auto& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        const auto* postings = FindPostings(word);
+        if (!postings) {
+            continue;
+        }
+        for (const auto& posting : *postings) {
+            if (is_matched[posting.document]) {
+                is_matched[posting.document] = false;
+                ++documents_removed;
+            }
+        }
+    }
+    if (profile) {
+        profile->documents_removed_by_minus_words += documents_removed;
+        finish_stage(profile->minus_words_time);
+    }
+
+    for (const InternalId document : matched) {
+        if (is_matched[document]) {
+            collect(document, document_to_relevance[document]);
+        }
+    }
+    if (profile) {
+        finish_stage(profile->ranking_time);
+    }
+}
+
+template <typename DocumentFilter>
+std::optional<std::vector<Document>> SearchServer::FindTopDocumentsByImpact(const Query& query, DocumentFilter document_filter) const {
+    using namespace std;
+
+    if (query.plus_words.empty() || query.plus_words.size() > MAX_IMPACT_QUERY_WORDS) {
+        return nullopt;
+    }
+    struct ImpactCursor {
+        const ImpactOrderedIndex::Postings* postings;
+        size_t position;
+        double inverse_document_freq;
+        TermId term;
+    };
+    vector<ImpactCursor> cursors;
+    for (const auto& word : query.plus_words) {
+        const auto term = terms_.Find(word);
+        if (!term || term_document_counts_[*term] == 0) {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.find(word)->second) {
-            document_to_relevance.erase(document_id);
+        const auto* postings = impact_index_.Find(*term);
+        if (!postings) {
+            return nullopt;
+        }
+        cursors.push_back({postings, 0, ComputeInverseDocumentFreq(term_postings_[*term]), *term});
+    }
+    if (cursors.empty()) {
+        return nullopt;
+    }
+    vector<TermId> minus_terms;
+    for (const auto& word : query.minus_words) {
+        if (const auto term = terms_.Find(word)) {
+            minus_terms.push_back(*term);
         }
     }
 
+    // Документ из списка одного слова ищет частоты остальных слов в прямом индексе
+    const auto score_document = [this, &cursors, &minus_terms](InternalId document) -> optional<double> {
+        const auto row = forward_index_.GetRow(document);
+        for (const TermId term : minus_terms) {
+            if (row.Contains(term)) {
+                return nullopt;
+            }
+        }
+        double relevance = 0.0;
+        for (const auto& cursor : cursors) {
+            if (const auto term_freq = row.FindFreq(cursor.term)) {
+                relevance += *term_freq * cursor.inverse_document_freq;
+            }
+        }
+        return relevance;
+    };
+
     vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back(
-            {document_id, relevance, documents_.at(document_id).rating});
+    unordered_set<InternalId> seen;
+    priority_queue<double, vector<double>, greater<double>> top_relevances;
+    while (true) {
+        double threshold = 0.0;
+        bool is_exhausted = true;
+        for (auto& cursor : cursors) {
+            const size_t end = min(cursor.position + IMPACT_BLOCK_SIZE, cursor.postings->size());
+            for (; cursor.position < end; ++cursor.position) {
+                const InternalId document = (*cursor.postings)[cursor.position].document;
+                if ((cursors.size() > 1 && !seen.insert(document).second) || !document_filter(document)) {
+                    continue;
+                }
+                const auto relevance = score_document(document);
+                if (!relevance) {
+                    continue;
+                }
+                matched_documents.push_back(MakeDocument(document, *relevance));
+                top_relevances.push(*relevance);
+                if (top_relevances.size() > MAX_RESULT_DOCUMENT_COUNT) {
+                    top_relevances.pop();
+                }
+            }
+            if (cursor.position < cursor.postings->size()) {
+                is_exhausted = false;
+                threshold += (*cursor.postings)[cursor.position].term_freq * cursor.inverse_document_freq;
+            }
+        }
+        // Непрочитанные документы уступают всем лучшим не только по релевантности, но и с учётом рейтинга
+        if (is_exhausted || (top_relevances.size() == MAX_RESULT_DOCUMENT_COUNT && threshold < top_relevances.top() - TOLERANCE)) {
+            break;
+        }
     }
+    RankDocuments(execution::seq, matched_documents);
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy& par, std::string_view raw_query, DocumentPredicate document_predicate) const {
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindAllConjunctiveDocuments(const Query& query, DocumentFilter document_filter) const {
     using namespace std;
 
-    auto query = ParseQuery(raw_query);
+    vector<PostingCursor> plus_cursors;
+    for (size_t word_index = 0; word_index < query.plus_words.size(); ++word_index) {
+        const auto* postings = FindPostings(query.plus_words[word_index]);
+        if (!postings || postings->empty()) {
+            return {};
+        }
+        plus_cursors.push_back({postings, postings->begin(), ComputeInverseDocumentFreq(*postings), word_index});
+    }
+    if (plus_cursors.empty()) {
+        return {};
+    }
+    sort(plus_cursors.begin(), plus_cursors.end(), [](const PostingCursor& lhs, const PostingCursor& rhs) {
+        return lhs.postings->size() < rhs.postings->size();
+    });
+
+    vector<PostingCursor> minus_cursors = MakeMinusCursors(query);
+
+    // Вклады слов суммируются в порядке слов запроса, как в FindAllDocuments
+    vector<double> word_relevance(plus_cursors.size());
+    vector<Document> matched_documents;
+    const auto& [rarest_postings, _, rarest_inverse_document_freq, rarest_word_index] = plus_cursors.front();
+    for (const auto& [document, term_freq] : *rarest_postings) {
+        if (!document_filter(document)) {
+            continue;
+        }
+        word_relevance[rarest_word_index] = term_freq * rarest_inverse_document_freq;
 
-    ConcurrentMap<int, double> document_to_relevance(8);
-    for_each(
-            par,
-            query.plus_words.begin(), query.plus_words.end(),
-            [this, &document_to_relevance, document_predicate](const auto& word){
-                auto it = word_to_document_freqs_.find(word);
-                if (it == word_to_document_freqs_.end()) {
-                    return;
+        bool is_matched = true;
+        for (size_t i = 1; i < plus_cursors.size() && is_matched; ++i) {
+            auto& cursor = plus_cursors[i];
+            if (!SeekPosting(cursor, document)) {
+                if (cursor.position == cursor.postings->end()) {
+                    return matched_documents;
                 }
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto [document_id, term_freq] : it->second) {
-                    const auto& document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                    }
+                is_matched = false;
+            } else {
+                word_relevance[cursor.word_index] = cursor.position->term_freq * cursor.inverse_document_freq;
+            }
+        }
+        for (size_t i = 0; i < minus_cursors.size() && is_matched; ++i) {
+            is_matched = !SeekPosting(minus_cursors[i], document);
+        }
+
+        if (is_matched) {
+            matched_documents.push_back(MakeDocument(document, accumulate(word_relevance.begin(), word_relevance.end(), 0.0)));
+        }
+    }
+    return matched_documents;
+}
+
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindAllDocumentsByDocument(const Query& query, DocumentFilter document_filter, QueryProfile* profile) const {
+    using namespace std;
+
+    vector<PostingCursor> plus_cursors;
+    for (size_t word_index = 0; word_index < query.plus_words.size(); ++word_index) {
+        const auto* postings = FindPostings(query.plus_words[word_index]);
+        if (postings && !postings->empty()) {
+            plus_cursors.push_back({postings, postings->begin(), ComputeInverseDocumentFreq(*postings), word_index});
+        }
+    }
+    vector<PostingCursor> minus_cursors = MakeMinusCursors(query);
+
+    // Куча курсоров с наименьшим текущим документом на вершине
+    const auto is_later = [&plus_cursors](size_t lhs, size_t rhs) {
+        return plus_cursors[lhs].position->document > plus_cursors[rhs].position->document;
+    };
+    vector<size_t> heap(plus_cursors.size());
+    iota(heap.begin(), heap.end(), 0);
+    make_heap(heap.begin(), heap.end(), is_later);
+
+    // Вклады слов суммируются в порядке слов запроса, как в FindAllDocuments
+    vector<double> word_relevance(query.plus_words.size());
+    vector<Document> matched_documents;
+    while (!heap.empty()) {
+        const InternalId document = plus_cursors[heap.front()].position->document;
+        // Фильтр и минус-слова проверяются до подсчёта релевантности; курсоры сдвигаются с документа в любом случае
+        const bool is_accepted = document_filter(document);
+        const bool is_matched = is_accepted
+            && none_of(minus_cursors.begin(), minus_cursors.end(), [document](PostingCursor& cursor) {
+                   return SeekPosting(cursor, document);
+               });
+        if (profile && is_accepted && !is_matched) {
+            ++profile->documents_removed_by_minus_words;
+        }
+        fill(word_relevance.begin(), word_relevance.end(), 0.0);
+        while (!heap.empty() && plus_cursors[heap.front()].position->document == document) {
+            pop_heap(heap.begin(), heap.end(), is_later);
+            auto& cursor = plus_cursors[heap.back()];
+            if (profile) {
+                ++profile->postings_visited;
+                profile->postings_accepted += is_accepted;
+            }
+            if (is_matched) {
+                word_relevance[cursor.word_index] = cursor.position->term_freq * cursor.inverse_document_freq;
+            }
+            if (++cursor.position == cursor.postings->end()) {
+                heap.pop_back();
+            } else {
+                push_heap(heap.begin(), heap.end(), is_later);
+            }
+        }
+        if (is_matched) {
+            matched_documents.push_back(MakeDocument(document, accumulate(word_relevance.begin(), word_relevance.end(), 0.0)));
+        }
+    }
+    return matched_documents;
+}
+
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindAllQuantizedDocuments(const Query& query, DocumentFilter document_filter) const {
+    using namespace std;
+
+    // Фильтр проверяется один раз на документ, чтобы не ветвиться в цикле по записям
+    const size_t document_count = document_external_ids_.size();
+    vector<uint32_t> accumulator(document_count);
+    vector<uint8_t> is_hit(document_count);
+    for (const auto& word : query.plus_words) {
+        if (const auto term = terms_.Find(word)) {
+            quantized_impacts_.Accumulate(*term, accumulator.data(), is_hit.data());
+        }
+    }
+    for (const auto& word : query.minus_words) {
+        if (const auto term = terms_.Find(word)) {
+            quantized_impacts_.Exclude(*term, is_hit.data());
+        }
+    }
+
+    const double scale = quantized_impacts_.GetScale();
+    vector<Document> matched_documents;
+    for (InternalId document = 0; document < document_count; ++document) {
+        if (is_hit[document] && document_filter(document)) {
+            matched_documents.push_back(MakeDocument(document, accumulator[document] * scale));
+        }
+    }
+    return matched_documents;
+}
+
+template <typename DocumentPredicate>
+TopDocuments SearchServer::FindTopDocumentsWithDeadline(std::string_view raw_query, const SearchDeadline& deadline, DocumentPredicate document_predicate) const {
+    return FindTopDocumentsWithDeadline(ParseQuery(raw_query), deadline, MakePredicateFilter(document_predicate));
+}
+
+template <typename DocumentFilter>
+TopDocuments SearchServer::FindTopDocumentsWithDeadline(const Query& query, const SearchDeadline& deadline, DocumentFilter document_filter) const {
+    using namespace std;
+
+    TopDocuments result;
+    const DocumentBitmap excluded = CollectPostingDocuments(query.minus_words);
+
+    vector<PostingCursor> plus_cursors;
+    for (size_t word_index = 0; word_index < query.plus_words.size(); ++word_index) {
+        const auto* postings = FindPostings(query.plus_words[word_index]);
+        if (postings && !postings->empty()) {
+            plus_cursors.push_back({postings, postings->begin(), ComputeInverseDocumentFreq(*postings), word_index});
+        }
+    }
+    stable_sort(plus_cursors.begin(), plus_cursors.end(), [](const PostingCursor& lhs, const PostingCursor& rhs) {
+        return lhs.inverse_document_freq > rhs.inverse_document_freq;
+    });
+
+    vector<double> document_to_relevance(document_external_ids_.size());
+    vector<bool> is_matched(document_external_ids_.size());
+    vector<InternalId> matched;
+    for (auto cursor = plus_cursors.begin(); cursor != plus_cursors.end() && !result.is_partial; ++cursor) {
+        const auto postings_end = cursor->postings->end();
+        while (cursor->position != postings_end) {
+            if (deadline.IsExpired()) {
+                result.is_partial = true;
+                break;
+            }
+            const auto block_end = cursor->position + min<ptrdiff_t>(DEADLINE_CHECK_BLOCK_SIZE, postings_end - cursor->position);
+            for (; cursor->position != block_end; ++cursor->position) {
+                const auto& [document, term_freq] = *cursor->position;
+                if (excluded.Test(document) || !document_filter(document)) {
+                    continue;
                 }
-        });
-
-    for_each(
-            par,
-            query.minus_words.begin(), query.minus_words.end(),
-            [this, &document_to_relevance](const auto& word) {
-                auto it = word_to_document_freqs_.find(word);
-                if (it != word_to_document_freqs_.end()) {
-                    for (const auto [document_id, _] : it->second) {
-                        document_to_relevance.erase(document_id);
-                    }
+                if (!is_matched[document]) {
+                    is_matched[document] = true;
+                    matched.push_back(document);
                 }
-        });
+                document_to_relevance[document] += term_freq * cursor->inverse_document_freq;
+            }
+        }
+    }
+
+    result.documents.reserve(matched.size());
+    for (const InternalId document : matched) {
+        result.documents.push_back(MakeDocument(document, document_to_relevance[document]));
+    }
+    RankDocuments(execution::seq, result.documents);
+    return result;
+}
+
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindAllDocumentsByRange(const Query& query, DocumentFilter document_filter, std::size_t count, ThreadPool& pool) const {
+    using namespace std;
+
+    vector<PostingCursor> plus_cursors;
+    for (size_t word_index = 0; word_index < query.plus_words.size(); ++word_index) {
+        const auto* postings = FindPostings(query.plus_words[word_index]);
+        if (postings && !postings->empty()) {
+            plus_cursors.push_back({postings, postings->begin(), ComputeInverseDocumentFreq(*postings), word_index});
+        }
+    }
+    if (plus_cursors.empty()) {
+        return {};
+    }
+    const vector<PostingCursor> minus_cursors = MakeMinusCursors(query);
+
+    const vector<DocumentRange> ranges = SplitDocumentRanges(static_cast<unsigned>(pool.GetThreadCount()));
+    vector<vector<Document>> range_documents(ranges.size());
+    pool.ParallelFor(0, ranges.size(), [&](size_t index) {
+        range_documents[index] = FindRangeDocuments(plus_cursors, minus_cursors, document_filter, ranges[index], count);
+    });
 
+    size_t matched_count = 0;
+    for (const auto& documents : range_documents) {
+        matched_count += documents.size();
+    }
     vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+    matched_documents.reserve(matched_count);
+    for (auto& documents : range_documents) {
+        move(documents.begin(), documents.end(), back_inserter(matched_documents));
+    }
+    return matched_documents;
+}
+
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindRangeDocuments(const std::vector<PostingCursor>& plus_cursors, const std::vector<PostingCursor>& minus_cursors,
+                                                       const DocumentFilter& document_filter, DocumentRange range, std::size_t count) const {
+    using namespace std;
+
+    const auto precedes = [](const Posting& posting, InternalId document) {
+        return posting.document < document;
+    };
+    const auto range_postings = [&precedes, range](const PostingCursor& cursor) {
+        const auto first = lower_bound(cursor.postings->begin(), cursor.postings->end(), range.begin, precedes);
+        return make_pair(first, lower_bound(first, cursor.postings->end(), range.end, precedes));
+    };
+
+    // Аккумуляторы покрывают только свой диапазон и не разделяются между потоками
+    vector<double> document_to_relevance(range.end - range.begin);
+    vector<bool> is_matched(range.end - range.begin);
+    vector<InternalId> matched;
+    for (const auto& cursor : plus_cursors) {
+        const auto [first, last] = range_postings(cursor);
+        for (auto it = first; it != last; ++it) {
+            if (document_filter(it->document)) {
+                const InternalId offset = it->document - range.begin;
+                if (!is_matched[offset]) {
+                    is_matched[offset] = true;
+                    matched.push_back(it->document);
+                }
+                document_to_relevance[offset] += it->term_freq * cursor.inverse_document_freq;
+            }
+        }
+    }
+    for (const auto& cursor : minus_cursors) {
+        const auto [first, last] = range_postings(cursor);
+        for (auto it = first; it != last; ++it) {
+            is_matched[it->document - range.begin] = false;
+        }
     }
 
+    vector<Document> matched_documents;
+    for (const InternalId document : matched) {
+        if (is_matched[document - range.begin]) {
+            matched_documents.push_back(MakeDocument(document, document_to_relevance[document - range.begin]));
+        }
+    }
+    if (matched_documents.size() > count) {
+        RankDocuments(execution::seq, matched_documents, count);
+    }
     return matched_documents;
 }
 
 template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words)) {
-    if (!std::all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+    : stop_words_(MakeStopWords(stop_words)) {
+}
+
+template <typename StringContainer>
+StopWordSet SearchServer::MakeStopWords(const StringContainer& stop_words) {
+    const auto words = MakeUniqueNonEmptyStrings(stop_words);
+    if (!std::all_of(words.begin(), words.end(), IsValidWord)) {
         throw std::invalid_argument("Some of stop words are invalid");
     }
+    return StopWordSet(words);
 }
 
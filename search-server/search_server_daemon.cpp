@@ -0,0 +1,148 @@
+#include "corpus_loader.h"
+#include "durable_search_server.h"
+#include "query_socket_server.h"
+#include "search_server.h"
+#include "thread_pool.h"
+
+#include <charconv>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <pthread.h>
+
+using namespace std;
+
+namespace {
+
+struct DaemonOptions {
+    string stop_words;
+    string corpus;
+    string index;
+    string unix_path;
+    optional<uint16_t> port;
+    size_t thread_count = 0;
+};
+
+const size_t MAX_THREAD_COUNT = 1024;
+
+// Десятичное число целиком, не больше max_value; nullopt для "abc", "12x", "-1" и переполнения
+optional<uint64_t> ParseNumber(string_view text, uint64_t max_value) {
+    uint64_t value = 0;
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || error != errc{} || end != text.data() + text.size() || value > max_value) {
+        return nullopt;
+    }
+    return value;
+}
+
+void PrintUsage() {
+    cerr << "Usage: search-server-daemon [--stop-words TEXT] (--corpus FILE | --index DIR) (--unix PATH | --port N) [--threads N]"s << endl;
+}
+
+optional<DaemonOptions> ParseOptions(int argc, char* argv[]) {
+    DaemonOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string_view name = argv[i];
+        if (i + 1 == argc) {
+            return nullopt;
+        }
+        const string value = argv[++i];
+        if (name == "--stop-words"sv) {
+            options.stop_words = value;
+        } else if (name == "--corpus"sv) {
+            options.corpus = value;
+        } else if (name == "--index"sv) {
+            options.index = value;
+        } else if (name == "--unix"sv) {
+            options.unix_path = value;
+        } else if (name == "--port"sv) {
+            const auto port = ParseNumber(value, numeric_limits<uint16_t>::max());
+            if (!port) {
+                return nullopt;
+            }
+            options.port = static_cast<uint16_t>(*port);
+        } else if (name == "--threads"sv) {
+            // 0 — по числу аппаратных потоков
+            const auto thread_count = ParseNumber(value, MAX_THREAD_COUNT);
+            if (!thread_count) {
+                return nullopt;
+            }
+            options.thread_count = static_cast<size_t>(*thread_count);
+        } else {
+            return nullopt;
+        }
+    }
+    if (options.corpus.empty() == options.index.empty() || options.unix_path.empty() != options.port.has_value()) {
+        return nullopt;
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const auto options = ParseOptions(argc, argv);
+    if (!options) {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    // Сигналы блокируются до создания потоков, чтобы их получал только поток остановки
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+    try {
+        unique_ptr<SearchServer> search_server;
+        unique_ptr<DurableSearchServer> durable_server;
+        if (!options->corpus.empty()) {
+            search_server = make_unique<SearchServer>(options->stop_words);
+            const size_t document_count = LoadCorpus(options->corpus, *search_server);
+            cerr << "Loaded "s << document_count << " documents from "s << options->corpus << endl;
+        } else {
+            durable_server = make_unique<DurableSearchServer>(options->index, options->stop_words);
+            cerr << "Recovered "s << durable_server->GetServer().GetDocumentCount() << " documents from "s << options->index << endl;
+        }
+        const SearchServer& server = durable_server ? durable_server->GetServer() : *search_server;
+
+        ThreadPool pool(options->thread_count);
+        QuerySocketServer socket_server(server, pool);
+        if (options->port) {
+            cerr << "Listening on 127.0.0.1:"s << socket_server.ListenTcp(*options->port) << endl;
+        } else {
+            socket_server.ListenUnix(options->unix_path);
+            cerr << "Listening on "s << options->unix_path << endl;
+        }
+
+        thread stopper([&socket_server, &stop_signals] {
+            int signal = 0;
+            sigwait(&stop_signals, &signal);
+            socket_server.Stop();
+        });
+        try {
+            socket_server.Run();
+        } catch (...) {
+            // Run завершился ошибкой, а поток остановки ещё ждёт сигнала
+            pthread_kill(stopper.native_handle(), SIGTERM);
+            stopper.join();
+            throw;
+        }
+        stopper.join();
+        cerr << "Served "s << socket_server.GetRequestCount() << " requests in "s << socket_server.GetBatchCount() << " batches"s << endl;
+    } catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+#include "sharded_search_server.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, string_view stop_words_text, ThreadPool& pool)
+    : pool_(pool) {
+    if (shard_count == 0) {
+        throw invalid_argument("Shard count must be positive"s);
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words_text);
+    }
+}
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, string_view stop_words_text)
+    : ShardedSearchServer(shard_count, stop_words_text, ThreadPool::GetDefault()) {
+}
+
+void ShardedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    // Повторный или отрицательный идентификатор отклоняет шард: повторный попадает в тот же шард
+    shards_[GetShardIndex(document_id)].AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::UpdateDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    shards_[GetShardIndex(document_id)].UpdateDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::UpdateDocument(int document_id, DocumentStatus status, const vector<int>& ratings) {
+    shards_[GetShardIndex(document_id)].UpdateDocument(document_id, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    shards_[GetShardIndex(document_id)].RemoveDocument(document_id);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
+    return FindAllShards(raw_query, [raw_query, status](const SearchServer& shard, const CorpusStatistics& statistics) {
+        return shard.FindTopDocumentsWithStatistics(raw_query, statistics, status);
+    });
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+MatchedDocuments ShardedSearchServer::MatchDocument(string_view raw_query, int document_id) const {
+    return shards_[GetShardIndex(document_id)].MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const auto& shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    return static_cast<size_t>(document_id) % shards_.size();
+}
+
+const SearchServer& ShardedSearchServer::GetShard(size_t index) const {
+    return shards_.at(index);
+}
+
+CorpusStatistics ShardedSearchServer::CollectStatistics(string_view raw_query) const {
+    vector<CorpusStatistics> shard_statistics(shards_.size());
+    pool_.ParallelFor(0, shards_.size(), [this, raw_query, &shard_statistics](size_t index) {
+        shard_statistics[index] = shards_[index].GetCorpusStatistics(raw_query);
+    });
+    CorpusStatistics statistics = move(shard_statistics.front());
+    for (size_t i = 1; i < shard_statistics.size(); ++i) {
+        statistics += shard_statistics[i];
+    }
+    return statistics;
+}
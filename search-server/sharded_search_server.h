@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+#include "thread_pool.h"
+
+// Документы распределены по нескольким SearchServer (шардам) по идентификатору документа.
+// Запрос выполняется в два прохода по всем шардам параллельно: сначала собирается статистика слов запроса,
+// затем каждый шард ищет лучшие документы с IDF по всем шардам, и их выдачи сливаются.
+// Поэтому релевантность совпадает с релевантностью одного SearchServer со всеми документами.
+// Изменения и поиск синхронизируются так же, как для обычного SearchServer.
+class ShardedSearchServer {
+public:
+    // Пул должен пережить сервер
+    ShardedSearchServer(std::size_t shard_count, std::string_view stop_words_text, ThreadPool& pool);
+    ShardedSearchServer(std::size_t shard_count, std::string_view stop_words_text);
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void UpdateDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void UpdateDocument(int document_id, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    MatchedDocuments MatchDocument(std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+
+    std::size_t GetShardCount() const;
+    std::size_t GetShardIndex(int document_id) const;
+    const SearchServer& GetShard(std::size_t index) const;
+
+private:
+    std::vector<SearchServer> shards_;
+    ThreadPool& pool_;
+
+    CorpusStatistics CollectStatistics(std::string_view raw_query) const;
+
+    template <typename FindShardDocuments>
+    std::vector<Document> FindAllShards(std::string_view raw_query, FindShardDocuments find_shard_documents) const;
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindAllShards(raw_query, [raw_query, &document_predicate](const SearchServer& shard, const CorpusStatistics& statistics) {
+        return shard.FindTopDocumentsWithStatistics(raw_query, statistics, document_predicate);
+    });
+}
+
+template <typename FindShardDocuments>
+std::vector<Document> ShardedSearchServer::FindAllShards(std::string_view raw_query, FindShardDocuments find_shard_documents) const {
+    using namespace std;
+
+    const CorpusStatistics statistics = CollectStatistics(raw_query);
+    vector<vector<Document>> shard_documents(shards_.size());
+    pool_.ParallelFor(0, shards_.size(), [this, &statistics, &shard_documents, &find_shard_documents](size_t index) {
+        shard_documents[index] = find_shard_documents(shards_[index], statistics);
+    });
+
+    // Выдача каждого шарда уже отсортирована и не длиннее MAX_RESULT_DOCUMENT_COUNT
+    vector<Document> documents;
+    for (const auto& shard_top : shard_documents) {
+        documents.insert(documents.end(), shard_top.begin(), shard_top.end());
+    }
+    const size_t count = min(documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    partial_sort(documents.begin(), documents.begin() + count, documents.end(), SearchServer::IsRankedBefore);
+    documents.resize(count);
+    return documents;
+}
@@ -0,0 +1,178 @@
+#include "stop_word_set.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+const size_t BLOOM_BITS_PER_WORD = 16;
+const size_t WORDS_PER_BUCKET = 4;
+const uint32_t MAX_DISPLACEMENT = 1 << 16;
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result *= 2;
+    }
+    return result;
+}
+
+// Финализатор SplitMix64
+uint64_t Mix(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+} // namespace
+
+bool StopWordSet::Contains(string_view word) const {
+    if (slots_.empty()) {
+        return false;
+    }
+    const uint64_t hash = Hash(word);
+    if (!MayContain(hash)) {
+        return false;
+    }
+    const uint32_t displacement = displacements_[(hash >> 40) & bucket_mask_];
+    const uint32_t slot = slots_[GetSlotHash(hash, displacement) & slot_mask_];
+    return slot != EMPTY_SLOT && GetWord(slot - 1) == word;
+}
+
+size_t StopWordSet::size() const {
+    return word_offsets_.empty() ? 0 : word_offsets_.size() - 1;
+}
+
+bool StopWordSet::empty() const {
+    return size() == 0;
+}
+
+vector<string_view> StopWordSet::GetWords() const {
+    vector<string_view> words;
+    words.reserve(size());
+    for (uint32_t index = 0; index < size(); ++index) {
+        words.push_back(GetWord(index));
+    }
+    return words;
+}
+
+MemoryUsage StopWordSet::GetMemoryUsage() const {
+    MemoryUsage usage = bloom_.get_allocator().GetUsage();
+    usage += displacements_.get_allocator().GetUsage();
+    usage += slots_.get_allocator().GetUsage();
+    usage += characters_.get_allocator().GetUsage();
+    usage += word_offsets_.get_allocator().GetUsage();
+    return usage;
+}
+
+void StopWordSet::Build(vector<string_view> words) {
+    words.erase(remove(words.begin(), words.end(), string_view{}), words.end());
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    if (words.empty()) {
+        return;
+    }
+
+    word_offsets_.push_back(0);
+    for (const string_view word : words) {
+        characters_.insert(characters_.end(), word.begin(), word.end());
+        word_offsets_.push_back(static_cast<uint32_t>(characters_.size()));
+    }
+
+    vector<uint64_t> hashes;
+    hashes.reserve(words.size());
+    for (const string_view word : words) {
+        hashes.push_back(Hash(word));
+    }
+
+    const size_t bloom_bits = RoundUpToPowerOfTwo(max<size_t>(words.size() * BLOOM_BITS_PER_WORD, 64));
+    bloom_.assign(bloom_bits / 64, 0);
+    bloom_mask_ = bloom_bits - 1;
+    for (const uint64_t hash : hashes) {
+        bloom_[(hash & bloom_mask_) / 64] |= uint64_t{1} << (hash & 63);
+        bloom_[((hash >> 20) & bloom_mask_) / 64] |= uint64_t{1} << ((hash >> 20) & 63);
+    }
+
+    // Чем свободнее таблица, тем быстрее подбираются смещения; обычно хватает первой попытки
+    for (size_t slot_count = RoundUpToPowerOfTwo(words.size());; slot_count *= 2) {
+        if (TryPlace(words, hashes, slot_count)) {
+            return;
+        }
+    }
+}
+
+bool StopWordSet::TryPlace(const vector<string_view>& words, const vector<uint64_t>& hashes, size_t slot_count) {
+    const size_t bucket_count = RoundUpToPowerOfTwo((words.size() + WORDS_PER_BUCKET - 1) / WORDS_PER_BUCKET);
+    bucket_mask_ = bucket_count - 1;
+    slot_mask_ = slot_count - 1;
+    displacements_.assign(bucket_count, 0);
+    slots_.assign(slot_count, EMPTY_SLOT);
+
+    vector<vector<uint32_t>> buckets(bucket_count);
+    for (uint32_t index = 0; index < words.size(); ++index) {
+        buckets[(hashes[index] >> 40) & bucket_mask_].push_back(index);
+    }
+    // Большие корзины размещаются первыми, пока таблица почти пуста
+    vector<size_t> order(bucket_count);
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        order[bucket] = bucket;
+    }
+    stable_sort(order.begin(), order.end(), [&buckets](size_t lhs, size_t rhs) {
+        return buckets[lhs].size() > buckets[rhs].size();
+    });
+
+    vector<uint64_t> bucket_slots;
+    for (const size_t bucket : order) {
+        const auto& indices = buckets[bucket];
+        if (indices.empty()) {
+            break;
+        }
+        bool is_placed = false;
+        for (uint32_t displacement = 0; displacement < MAX_DISPLACEMENT && !is_placed; ++displacement) {
+            bucket_slots.clear();
+            is_placed = true;
+            for (const uint32_t index : indices) {
+                const uint64_t slot = GetSlotHash(hashes[index], displacement) & slot_mask_;
+                if (slots_[slot] != EMPTY_SLOT || find(bucket_slots.begin(), bucket_slots.end(), slot) != bucket_slots.end()) {
+                    is_placed = false;
+                    break;
+                }
+                bucket_slots.push_back(slot);
+            }
+            if (is_placed) {
+                displacements_[bucket] = displacement;
+                for (size_t i = 0; i < indices.size(); ++i) {
+                    slots_[bucket_slots[i]] = indices[i] + 1;
+                }
+            }
+        }
+        if (!is_placed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+string_view StopWordSet::GetWord(uint32_t index) const {
+    return {characters_.data() + word_offsets_[index], word_offsets_[index + 1] - word_offsets_[index]};
+}
+
+uint64_t StopWordSet::Hash(string_view word) {
+    // FNV-1a; перемешивание делает независимыми биты, из которых берутся индексы
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char c : word) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    }
+    return Mix(hash);
+}
+
+uint64_t StopWordSet::GetSlotHash(uint64_t hash, uint32_t displacement) {
+    return Mix(hash + displacement * 0x9e3779b97f4a7c15ULL);
+}
+
+bool StopWordSet::MayContain(uint64_t hash) const {
+    const uint64_t first = hash & bloom_mask_;
+    const uint64_t second = (hash >> 20) & bloom_mask_;
+    return ((bloom_[first / 64] >> (first & 63)) & (bloom_[second / 64] >> (second & 63)) & 1) != 0;
+}
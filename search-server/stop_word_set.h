@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "memory_accounting.h"
+
+// Неизменяемое множество стоп-слов: совершенная хеш-функция (hash and displace)
+// и перед ней фильтр Блума. Хеш слова считается один раз; большинство обычных слов
+// отсекает фильтр по двум битам, а для остальных сравнивается единственная строка из таблицы.
+class StopWordSet {
+public:
+    StopWordSet() = default;
+
+    // Пустые и повторяющиеся слова пропускаются
+    template <typename StringContainer>
+    explicit StopWordSet(const StringContainer& words);
+
+    bool Contains(std::string_view word) const;
+
+    std::size_t size() const;
+    bool empty() const;
+
+    // В лексикографическом порядке; представления живут, пока живо множество
+    std::vector<std::string_view> GetWords() const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    template <typename T>
+    using Vector = std::vector<T, CountingAllocator<T>>;
+
+    static constexpr std::uint32_t EMPTY_SLOT = 0;
+
+    // Битовый массив фильтра и таблица — степени двойки, индексы берутся маской
+    Vector<std::uint64_t> bloom_;
+    std::uint64_t bloom_mask_ = 0;
+    // Смещение хеша для каждой корзины подобрано так, что слова попадают в разные ячейки
+    Vector<std::uint32_t> displacements_;
+    std::uint64_t bucket_mask_ = 0;
+    // Номер слова + 1 или EMPTY_SLOT
+    Vector<std::uint32_t> slots_;
+    std::uint64_t slot_mask_ = 0;
+    // Слова подряд; слово i занимает [word_offsets_[i], word_offsets_[i + 1])
+    Vector<char> characters_;
+    Vector<std::uint32_t> word_offsets_;
+
+    void Build(std::vector<std::string_view> words);
+    bool TryPlace(const std::vector<std::string_view>& words, const std::vector<std::uint64_t>& hashes, std::size_t slot_count);
+
+    std::string_view GetWord(std::uint32_t index) const;
+
+    static std::uint64_t Hash(std::string_view word);
+    static std::uint64_t GetSlotHash(std::uint64_t hash, std::uint32_t displacement);
+    bool MayContain(std::uint64_t hash) const;
+};
+
+template <typename StringContainer>
+StopWordSet::StopWordSet(const StringContainer& words) {
+    std::vector<std::string_view> views;
+    for (const auto& word : words) {
+        views.push_back(word);
+    }
+    Build(std::move(views));
+}
@@ -8,9 +8,9 @@
 
 std::vector<std::string_view> SplitIntoWords(std::string_view str);
 
-template <typename StringContainer>
-std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-    std::set<std::string, std::less<>> non_empty_strings;
+template <typename StringSet = std::set<std::string, std::less<>>, typename StringContainer>
+StringSet MakeUniqueNonEmptyStrings(const StringContainer& strings) {
+    StringSet non_empty_strings;
     for (const auto& str : strings) {
         if (!str.empty()) {
             non_empty_strings.insert(std::string{str});
@@ -0,0 +1,59 @@
+#include "term_dictionary.h"
+
+using namespace std;
+
+TermDictionary::TermDictionary(const TermDictionary& other)
+    : word_to_term_(other.word_to_term_) {
+    RebuildTermWords();
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if (this != &other) {
+        word_to_term_ = other.word_to_term_;
+        RebuildTermWords();
+    }
+    return *this;
+}
+
+optional<TermId> TermDictionary::Find(string_view word) const {
+    const auto it = word_to_term_.find(word);
+    if (it == word_to_term_.end()) {
+        return nullopt;
+    }
+    return it->second;
+}
+
+TermId TermDictionary::Insert(string_view word) {
+    auto it = word_to_term_.find(word);
+    if (it == word_to_term_.end()) {
+        const TermId term = static_cast<TermId>(term_to_word_.size());
+        it = word_to_term_.emplace(string{word}, term).first;
+        term_to_word_.push_back(it->first);
+    }
+    return it->second;
+}
+
+string_view TermDictionary::GetWord(TermId term) const {
+    return term_to_word_[term];
+}
+
+size_t TermDictionary::size() const {
+    return term_to_word_.size();
+}
+
+MemoryUsage TermDictionary::GetMemoryUsage() const {
+    MemoryUsage usage = word_to_term_.get_allocator().GetUsage();
+    usage += term_to_word_.get_allocator().GetUsage();
+    for (const auto& [word, _] : word_to_term_) {
+        AddStringUsage(usage, word);
+    }
+    return usage;
+}
+
+// Копии слов ссылаются на строки собственного словаря, а не на строки источника
+void TermDictionary::RebuildTermWords() {
+    term_to_word_.assign(word_to_term_.size(), string_view{});
+    for (const auto& [word, term] : word_to_term_) {
+        term_to_word_[term] = word;
+    }
+}
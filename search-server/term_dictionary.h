@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "memory_accounting.h"
+
+using TermId = std::uint32_t;
+
+// Словарь индекса: каждому слову назначается плотный идентификатор в порядке добавления
+class TermDictionary {
+public:
+    TermDictionary() = default;
+    TermDictionary(const TermDictionary& other);
+    TermDictionary(TermDictionary&& other) = default;
+    TermDictionary& operator=(const TermDictionary& other);
+    TermDictionary& operator=(TermDictionary&& other) = default;
+
+    std::optional<TermId> Find(std::string_view word) const;
+
+    // Возвращает идентификатор слова, добавляя слово при необходимости
+    TermId Insert(std::string_view word);
+
+    // Строка принадлежит словарю и живёт, пока жив словарь
+    std::string_view GetWord(TermId term) const;
+
+    std::size_t size() const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    std::map<std::string, TermId, std::less<>, CountingAllocator<std::pair<const std::string, TermId>>> word_to_term_;
+    std::vector<std::string_view, CountingAllocator<std::string_view>> term_to_word_;
+
+    void RebuildTermWords();
+};
@@ -0,0 +1,121 @@
+#include "term_top_documents.h"
+
+using namespace std;
+
+TermTopDocuments::TermTopDocuments(size_t status_count, size_t capacity, size_t min_posting_count)
+    : status_count_(status_count)
+    , capacity_(max<size_t>(capacity, 1))
+    , min_posting_count_(min_posting_count) {
+}
+
+TermTopDocuments::TermTopDocuments(const TermTopDocuments& other)
+    : status_count_(other.status_count_)
+    , capacity_(other.capacity_)
+    , min_posting_count_(other.min_posting_count_) {
+    lock_guard guard(other.refill_mutex_);
+    entries_ = other.entries_;
+    unlisted_ = other.unlisted_;
+}
+
+TermTopDocuments::TermTopDocuments(TermTopDocuments&& other)
+    : status_count_(other.status_count_)
+    , capacity_(other.capacity_)
+    , min_posting_count_(other.min_posting_count_)
+    , entries_(move(other.entries_))
+    , unlisted_(move(other.unlisted_)) {
+}
+
+TermTopDocuments& TermTopDocuments::operator=(const TermTopDocuments& other) {
+    if (this != &other) {
+        lock_guard guard(other.refill_mutex_);
+        status_count_ = other.status_count_;
+        capacity_ = other.capacity_;
+        min_posting_count_ = other.min_posting_count_;
+        entries_ = other.entries_;
+        unlisted_ = other.unlisted_;
+    }
+    return *this;
+}
+
+TermTopDocuments& TermTopDocuments::operator=(TermTopDocuments&& other) {
+    status_count_ = other.status_count_;
+    capacity_ = other.capacity_;
+    min_posting_count_ = other.min_posting_count_;
+    entries_ = move(other.entries_);
+    unlisted_ = move(other.unlisted_);
+    return *this;
+}
+
+size_t TermTopDocuments::GetMinPostingCount() const {
+    return min_posting_count_;
+}
+
+MemoryUsage TermTopDocuments::GetMemoryUsage() const {
+    MemoryUsage usage = entries_.get_allocator().outer_allocator().GetUsage();
+    usage += unlisted_.get_allocator().GetUsage();
+    return usage;
+}
+
+bool TermTopDocuments::IsBefore(const Entry& lhs, const Entry& rhs) {
+    if (lhs.term_freq != rhs.term_freq) {
+        return lhs.term_freq > rhs.term_freq;
+    }
+    return lhs.document < rhs.document;
+}
+
+void TermTopDocuments::Assign(const Key& key, vector<Entry>& candidates) const {
+    const size_t listed_count = min(capacity_, candidates.size());
+    partial_sort(candidates.begin(), candidates.begin() + listed_count, candidates.end(), IsBefore);
+
+    auto& entries = entries_[key];
+    entries.assign(candidates.begin(), candidates.begin() + listed_count);
+    Unlisted& unlisted = unlisted_[key];
+    unlisted = Unlisted{};
+    for (auto it = candidates.begin() + listed_count; it != candidates.end(); ++it) {
+        AddUnlisted(unlisted, it->term_freq);
+    }
+}
+
+void TermTopDocuments::Insert(const Key& key, uint32_t document, double term_freq) {
+    auto& entries = entries_.at(key);
+    Unlisted& unlisted = unlisted_.at(key);
+
+    // Поредевший список остаётся началом упорядоченных документов статуса:
+    // документ после последнего отобранного может уступать неотобранным
+    const Entry entry{document, term_freq};
+    const bool is_after_listed = entries.empty() || !IsBefore(entry, entries.back());
+    if (is_after_listed && (entries.size() == capacity_ || unlisted.count > 0)) {
+        AddUnlisted(unlisted, term_freq);
+        return;
+    }
+    entries.insert(upper_bound(entries.begin(), entries.end(), entry, IsBefore), entry);
+    if (entries.size() > capacity_) {
+        AddUnlisted(unlisted, entries.back().term_freq);
+        entries.pop_back();
+    }
+}
+
+void TermTopDocuments::Detach(const Key& key, uint32_t document, double term_freq) {
+    auto& entries = entries_.at(key);
+    Unlisted& unlisted = unlisted_.at(key);
+
+    const auto it = lower_bound(entries.begin(), entries.end(), Entry{document, term_freq}, IsBefore);
+    if (it != entries.end() && it->document == document) {
+        // Остальные отобранные документы по-прежнему лучше неотобранных, список только укорачивается
+        entries.erase(it);
+        return;
+    }
+    // Оценка сверху остаётся верной и без пересчёта
+    if (--unlisted.count == 0) {
+        unlisted.max_term_freq = 0.0;
+    }
+}
+
+bool TermTopDocuments::Contains(TermId term) const {
+    return entries_.count({term, 0}) > 0;
+}
+
+void TermTopDocuments::AddUnlisted(Unlisted& unlisted, double term_freq) {
+    ++unlisted.count;
+    unlisted.max_term_freq = max(unlisted.max_term_freq, term_freq);
+}
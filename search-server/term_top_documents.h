@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <scoped_allocator>
+#include <utility>
+#include <vector>
+
+#include "memory_accounting.h"
+#include "term_dictionary.h"
+
+// Для слов с длинными списками документов — до capacity документов каждого статуса
+// с наибольшей частотой слова. IDF у документов слова общий, поэтому это и лучшие документы
+// однословного запроса. Про остальные документы статуса хранятся их число и оценка сверху частоты:
+// по ней поиск проверяет, что выдача из отобранных документов совпадает с полным подсчётом.
+// Удалённый из списка документ не замещается сразу: список статуса перестраивается при поиске,
+// когда в нём осталось меньше половины capacity, а неотобранные документы ещё есть.
+// Статусы передаются как индексы от 0 до status_count - 1, statuses[document] — статус документа;
+// документы с другими статусами (например, удалённые, но ещё записанные в postings) не отбираются.
+class TermTopDocuments {
+public:
+    struct Entry {
+        std::uint32_t document;
+        double term_freq;
+    };
+
+    using Entries = std::vector<Entry, CountingAllocator<Entry>>;
+
+    // Документы статуса, не попавшие в список
+    struct Unlisted {
+        std::size_t count = 0;
+        double max_term_freq = 0.0;
+    };
+
+    struct TopList {
+        // По убыванию частоты, при равенстве — по возрастанию документа
+        const Entries* entries;
+        Unlisted unlisted;
+    };
+
+    // Порог, при котором списки не строятся ни для одного слова
+    static constexpr std::size_t DISABLED = 0;
+
+    TermTopDocuments(std::size_t status_count, std::size_t capacity, std::size_t min_posting_count = DISABLED);
+
+    // Мьютекс перестроения не копируется и не перемещается
+    TermTopDocuments(const TermTopDocuments& other);
+    TermTopDocuments(TermTopDocuments&& other);
+    TermTopDocuments& operator=(const TermTopDocuments& other);
+    TermTopDocuments& operator=(TermTopDocuments&& other);
+
+    std::size_t GetMinPostingCount() const;
+
+    // Отбирает документы слова, если порог задан и список слова не короче его
+    template <typename Postings, typename Statuses>
+    void Build(TermId term, const Postings& postings, const Statuses& statuses);
+
+    // Вызываются после изменения обычного списка слова; postings — его новое содержимое,
+    // posting_count — число документов слова после удаления
+    template <typename Postings, typename Statuses>
+    void Add(TermId term, std::uint32_t document, double term_freq, const Postings& postings, const Statuses& statuses);
+    template <typename Statuses>
+    void Remove(TermId term, std::uint32_t document, double term_freq, std::size_t posting_count, const Statuses& statuses);
+    // Частота документа в списке слова изменилась с old_term_freq на term_freq
+    template <typename Statuses>
+    void Update(TermId term, std::uint32_t document, double old_term_freq, double term_freq, const Statuses& statuses);
+    // Вызывается после изменения статуса документа в statuses; список слова не меняется
+    template <typename Statuses>
+    void ChangeStatus(TermId term, std::uint32_t document, double term_freq, std::size_t old_status, const Statuses& statuses);
+
+    // nullopt, если список слова слишком короткий. Поредевший список статуса перестраивается по postings и statuses;
+    // поиски из нескольких потоков допустимы, пока списки не меняются
+    template <typename Postings, typename Statuses>
+    std::optional<TopList> Find(TermId term, std::size_t status, const Postings& postings, const Statuses& statuses) const;
+
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    using Key = std::pair<TermId, std::size_t>;
+
+    std::size_t status_count_;
+    std::size_t capacity_;
+    std::size_t min_posting_count_;
+    mutable std::mutex refill_mutex_;
+    mutable std::map<Key, Entries, std::less<Key>,
+                     std::scoped_allocator_adaptor<CountingAllocator<std::pair<const Key, Entries>>>> entries_;
+    mutable std::map<Key, Unlisted, std::less<Key>, CountingAllocator<std::pair<const Key, Unlisted>>> unlisted_;
+
+    static bool IsBefore(const Entry& lhs, const Entry& rhs);
+
+    bool Contains(TermId term) const;
+
+    // Списки всех статусов слова
+    template <typename Postings, typename Statuses>
+    void Fill(TermId term, const Postings& postings, const Statuses& statuses);
+
+    // Список одного статуса; списки остальных статусов не трогаются, их могут читать другие поиски
+    template <typename Postings, typename Statuses>
+    void Refill(const Key& key, const Postings& postings, const Statuses& statuses) const;
+
+    void Assign(const Key& key, std::vector<Entry>& candidates) const;
+
+    // Добавляет документ в список статуса или в оценку неотобранных
+    void Insert(const Key& key, std::uint32_t document, double term_freq);
+
+    // Убирает документ из списка статуса или из оценки неотобранных
+    void Detach(const Key& key, std::uint32_t document, double term_freq);
+
+    // Вытесненный из списка документ попадает в оценку остальных
+    static void AddUnlisted(Unlisted& unlisted, double term_freq);
+};
+
+template <typename Postings, typename Statuses>
+void TermTopDocuments::Build(TermId term, const Postings& postings, const Statuses& statuses) {
+    if (min_posting_count_ != DISABLED && postings.size() >= min_posting_count_) {
+        Fill(term, postings, statuses);
+    }
+}
+
+template <typename Postings, typename Statuses>
+void TermTopDocuments::Fill(TermId term, const Postings& postings, const Statuses& statuses) {
+    std::vector<std::vector<Entry>> candidates(status_count_);
+    for (const auto& posting : postings) {
+        const auto status = static_cast<std::size_t>(statuses[posting.document]);
+        if (status < status_count_) {
+            candidates[status].push_back({posting.document, posting.term_freq});
+        }
+    }
+    for (std::size_t status = 0; status < status_count_; ++status) {
+        Assign({term, status}, candidates[status]);
+    }
+}
+
+template <typename Postings, typename Statuses>
+void TermTopDocuments::Refill(const Key& key, const Postings& postings, const Statuses& statuses) const {
+    std::vector<Entry> candidates;
+    for (const auto& posting : postings) {
+        if (static_cast<std::size_t>(statuses[posting.document]) == key.second) {
+            candidates.push_back({posting.document, posting.term_freq});
+        }
+    }
+    Assign(key, candidates);
+}
+
+template <typename Postings, typename Statuses>
+std::optional<TermTopDocuments::TopList> TermTopDocuments::Find(TermId term, std::size_t status, const Postings& postings, const Statuses& statuses) const {
+    const auto entries = entries_.find({term, status});
+    if (entries == entries_.end()) {
+        return std::nullopt;
+    }
+    std::lock_guard guard(refill_mutex_);
+    const Unlisted& unlisted = unlisted_.at({term, status});
+    if (entries->second.size() < capacity_ / 2 && unlisted.count > 0) {
+        Refill(entries->first, postings, statuses);
+    }
+    return TopList{&entries->second, unlisted};
+}
+
+template <typename Postings, typename Statuses>
+void TermTopDocuments::Add(TermId term, std::uint32_t document, double term_freq, const Postings& postings, const Statuses& statuses) {
+    if (!Contains(term)) {
+        Build(term, postings, statuses);
+        return;
+    }
+    Insert({term, static_cast<std::size_t>(statuses[document])}, document, term_freq);
+}
+
+template <typename Statuses>
+void TermTopDocuments::Remove(TermId term, std::uint32_t document, double term_freq, std::size_t posting_count, const Statuses& statuses) {
+    if (!Contains(term)) {
+        return;
+    }
+    // Списки удаляются, только когда слово стало вдвое реже порога, чтобы не перестраивать их на границе
+    if (posting_count < min_posting_count_ / 2) {
+        entries_.erase(entries_.lower_bound({term, 0}), entries_.lower_bound({term + 1, 0}));
+        unlisted_.erase(unlisted_.lower_bound({term, 0}), unlisted_.lower_bound({term + 1, 0}));
+        return;
+    }
+    Detach({term, static_cast<std::size_t>(statuses[document])}, document, term_freq);
+}
+
+template <typename Statuses>
+void TermTopDocuments::Update(TermId term, std::uint32_t document, double old_term_freq, double term_freq, const Statuses& statuses) {
+    if (!Contains(term)) {
+        return;
+    }
+    const Key key{term, static_cast<std::size_t>(statuses[document])};
+    Detach(key, document, old_term_freq);
+    Insert(key, document, term_freq);
+}
+
+template <typename Statuses>
+void TermTopDocuments::ChangeStatus(TermId term, std::uint32_t document, double term_freq, std::size_t old_status, const Statuses& statuses) {
+    if (!Contains(term)) {
+        return;
+    }
+    Detach({term, old_status}, document, term_freq);
+    Insert({term, static_cast<std::size_t>(statuses[document])}, document, term_freq);
+}
@@ -6,12 +6,42 @@
 #include "process_queries.h"
 #include "request_queue.h"
 #include "test_framework.h"
+#include "paginator.h"
+#include "thread_pool.h"
+#include "async_request_queue.h"
+#include "stop_word_set.h"
+#include "binary_encoding.h"
+#include "sharded_search_server.h"
+#include "concurrent_map.h"
+#if defined(__linux__)
+#include "durable_search_server.h"
+#include "corpus_loader.h"
+#include "query_socket_server.h"
+#endif
 
 #include <string>
 #include <vector>
 #include <stdexcept>
 #include <iostream>
 #include <random>
+#include <optional>
+#include <map>
+#include <array>
+#include <limits>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <system_error>
+
+// Журнал, загрузка корпуса и сервер запросов собираются только для Linux
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -383,6 +413,1539 @@ void TestCalculationOfRelevanceAddedDocuments() {
     }
 }
 
+void TestExplainQuery() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    server.AddDocument(2, "dog in the city"s, DocumentStatus::ACTUAL, {4, 5, 6});
+    server.AddDocument(3, "cat and dog"s, DocumentStatus::BANNED, {7});
+    {
+        const auto [documents, profile] = server.ExplainFindTopDocuments("cat and city -dog"s);
+        const auto expected = server.FindTopDocuments("cat and city -dog"s);
+        ASSERT_EQUAL(documents.size(), expected.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL_HINT(documents[i].id, expected[i].id, "Explain must return the same documents"s);
+        }
+        ASSERT_EQUAL(profile.plus_terms.size(), 2u);
+        ASSERT_EQUAL(profile.plus_terms[0].word, "cat"sv);
+        ASSERT_EQUAL(profile.plus_terms[0].posting_count, 2u);
+        ASSERT(abs(profile.plus_terms[0].inverse_document_freq - log(3.0 / 2)) < 1e-6);
+        ASSERT_EQUAL(profile.minus_terms.size(), 1u);
+        ASSERT_EQUAL(profile.minus_terms[0].posting_count, 2u);
+        ASSERT_EQUAL_HINT(profile.postings_visited, 4u, "Postings of all plus words must be visited"s);
+        ASSERT_EQUAL_HINT(profile.postings_accepted, 3u, "Postings of banned documents must be rejected"s);
+        ASSERT_EQUAL_HINT(profile.documents_removed_by_minus_words, 1u, "Only scored documents are removed"s);
+        ASSERT(profile.execution == QueryExecution::TERM_AT_A_TIME);
+    }
+    {
+        // Explain идёт той же веткой поиска, что и FindTopDocuments, и сообщает, какой
+        SearchServer indexed = server;
+        indexed.SetTermTopDocumentsThreshold(1);
+        indexed.SetImpactOrderThreshold(1);
+        const auto [term_top_documents, term_top_profile] = indexed.ExplainFindTopDocuments("city"s);
+        ASSERT(term_top_profile.execution == QueryExecution::TERM_TOP_DOCUMENTS);
+        ASSERT_EQUAL(term_top_documents.size(), indexed.FindTopDocuments("city"s).size());
+
+        const auto is_actual = [](int document_id, DocumentStatus status, int rating) {
+            return status == DocumentStatus::ACTUAL;
+        };
+        const auto [impact_documents, impact_profile] = indexed.ExplainFindTopDocuments("cat city"s, is_actual);
+        ASSERT(impact_profile.execution == QueryExecution::IMPACT_ORDERED);
+        const auto expected = indexed.FindTopDocuments("cat city"s, is_actual);
+        ASSERT_EQUAL(impact_documents.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(impact_documents[i].id, expected[i].id);
+        }
+    }
+    {
+        const auto [matched, profile] = server.ExplainMatchDocument("cat city -fish"s, 1);
+        ASSERT_EQUAL(get<0>(matched), (vector<string_view>{"cat"sv, "city"sv}));
+        ASSERT_EQUAL(profile.postings_accepted, 2u);
+        ASSERT_EQUAL(profile.minus_terms[0].posting_count, 0u);
+        ASSERT_EQUAL(profile.documents_removed_by_minus_words, 0u);
+    }
+}
+
+void TestMemoryReport() {
+    SearchServer server("and in"s);
+    const auto empty_total = server.GetMemoryReport().GetTotal();
+
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    server.AddDocument(2, "dog and cat"s, DocumentStatus::ACTUAL, {4, 5, 6});
+    server.QuantizeImpacts(ImpactPrecision::BITS_8);
+    server.SetImpactOrderThreshold(1);
+    server.SetTermTopDocumentsThreshold(1);
+    const auto report = server.GetMemoryReport();
+    ASSERT_EQUAL(report.term_count, 4u);
+    ASSERT_EQUAL(report.posting_count, 5u);
+    ASSERT(abs(report.average_posting_length - 5.0 / 4) < 1e-6);
+    ASSERT_EQUAL(report.structures.size(), 11u);
+    for (const auto& [name, usage] : report.structures) {
+        ASSERT_HINT(usage.bytes > 0, name + " must allocate memory"s);
+        ASSERT_HINT(usage.footprint >= usage.bytes, "Footprint must include allocator overhead"s);
+    }
+    ASSERT(report.GetTotal().bytes > empty_total.bytes);
+
+    const SearchServer copy = server;
+    const auto copy_total = copy.GetMemoryReport().GetTotal();
+    server.RemoveDocument(1);
+    server.RemoveDocument(2);
+    const auto after_remove = server.GetMemoryReport();
+    ASSERT_HINT(after_remove.GetTotal().bytes < report.GetTotal().bytes, "Removed documents must release memory"s);
+    ASSERT_EQUAL(after_remove.posting_count, 0u);
+    ASSERT_EQUAL_HINT(copy.GetMemoryReport().GetTotal().bytes, copy_total.bytes, "Copies must be accounted separately"s);
+}
+
+void TestPagedSearch() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "cat and dog"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "cat dog bird"s, DocumentStatus::ACTUAL, {3});
+    server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, {4});
+    server.AddDocument(5, "cat cat dog"s, DocumentStatus::ACTUAL, {5});
+    server.AddDocument(6, "bird"s, DocumentStatus::BANNED, {6});
+    server.AddDocument(7, "cat dog"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(8, "fish"s, DocumentStatus::ACTUAL, {8});
+
+    const string query = "cat dog bird"s;
+    const vector<int> expected = {3, 5, 4, 2, 7, 1};
+
+    vector<int> by_offset;
+    for (size_t offset = 0; offset < expected.size(); offset += 4) {
+        for (const auto& document : server.FindDocumentsPage(query, offset, 4).documents) {
+            by_offset.push_back(document.id);
+        }
+    }
+    ASSERT_EQUAL_HINT(by_offset, expected, "Pages must follow relevance order without the top limit"s);
+    ASSERT_HINT(server.FindDocumentsPage(query, expected.size(), 4).documents.empty(), "Pages past the end must be empty"s);
+
+    vector<int> by_cursor;
+    SearchCursor cursor;
+    for (auto page = server.FindDocumentsPage(query, cursor, 4); !page.documents.empty();
+         page = server.FindDocumentsPage(query, page.next, 4)) {
+        for (const auto& document : page.documents) {
+            by_cursor.push_back(document.id);
+        }
+    }
+    ASSERT_EQUAL_HINT(by_cursor, expected, "Cursor must resume right after the last returned document"s);
+
+    vector<size_t> page_sizes;
+    vector<int> by_paginator;
+    for (const auto page : Paginate(server, query, 4)) {
+        page_sizes.push_back(page.size());
+        for (const auto& document : page) {
+            by_paginator.push_back(document.id);
+        }
+    }
+    ASSERT_EQUAL(page_sizes, (vector<size_t>{4, 2}));
+    ASSERT_EQUAL(by_paginator, expected);
+
+    vector<int> by_temporary_query;
+    for (const auto page : Paginate(server, "cat dog bird"s, 4)) {
+        for (const auto& document : page) {
+            by_temporary_query.push_back(document.id);
+        }
+    }
+    ASSERT_EQUAL_HINT(by_temporary_query, expected, "Paginator must keep its own copy of the query"s);
+
+    const auto banned = server.FindDocumentsPage(query, DocumentStatus::BANNED, 0, 4).documents;
+    ASSERT_EQUAL(banned.size(), 1u);
+    ASSERT_EQUAL(banned.front().id, 6);
+    const auto banned_page = server.FindDocumentsPage(query, DocumentStatus::BANNED, SearchCursor{}, 4);
+    ASSERT_EQUAL(banned_page.documents.size(), 1u);
+    ASSERT_HINT(server.FindDocumentsPage(query, DocumentStatus::BANNED, banned_page.next, 4).documents.empty(),
+                "Status pages must resume after the cursor"s);
+
+    const auto top = server.FindTopDocuments(query);
+    for (size_t i = 0; i < top.size(); ++i) {
+        ASSERT_EQUAL_HINT(top[i].id, expected[i], "Pages must agree with FindTopDocuments"s);
+    }
+}
+
+void TestForwardIndex() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "cat and dog"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "dog dog bird"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "fish cat fish cat"s, DocumentStatus::ACTUAL, {3});
+
+    map<string, double> expected = {{"dog"s, 2.0 / 3}, {"bird"s, 1.0 / 3}};
+    map<string, double> word_freqs;
+    for (const auto [word, freq] : server.GetWordFrequencies(2)) {
+        word_freqs[string{word}] = freq;
+    }
+    ASSERT_EQUAL(word_freqs.size(), expected.size());
+    for (const auto& [word, freq] : expected) {
+        ASSERT_HINT(abs(word_freqs.at(word) - freq) < 1e-6, "Word frequencies must survive in forward index"s);
+    }
+    ASSERT(server.GetWordFrequencies(42).empty());
+    {
+        // Итератор временного представления строки остаётся действительным
+        auto it = server.GetWordFrequencies(2).begin();
+        const auto [word, freq] = *it++;
+        ASSERT_EQUAL(word, "dog"sv);
+        ASSERT_EQUAL((*it).first, "bird"sv);
+        ASSERT(abs(freq - 2.0 / 3) < 1e-6);
+    }
+
+    optional<SearchServer> original(server);
+    const SearchServer copy = *original;
+    original.reset();
+
+    // удаление первых документов приводит к уплотнению прямого индекса
+    server.RemoveDocument(1);
+    server.RemoveDocument(execution::par, 2);
+    const auto freqs = server.GetWordFrequencies(3);
+    ASSERT_EQUAL(freqs.size(), 2u);
+    ASSERT(abs(*freqs.Find("fish"sv) - 0.5) < 1e-6);
+    ASSERT(!freqs.Find("dog"sv));
+
+    const auto [words, status] = server.MatchDocument(execution::par, "cat -dog fish"s, 3);
+    ASSERT_EQUAL(words, (vector<string_view>{"cat"sv, "fish"sv}));
+    const auto [copy_words, copy_status] = copy.MatchDocument("bird dog -fish"s, 2);
+    ASSERT_EQUAL_HINT(copy_words, (vector<string_view>{"bird"sv, "dog"sv}), "Copies must own their dictionary"s);
+}
+
+void TestExternalDocumentIds() {
+    SearchServer server(""s);
+    server.AddDocument(10, "white cat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(3, "black cat"s, DocumentStatus::BANNED, {2});
+    server.AddDocument(7, "white dog"s, DocumentStatus::ACTUAL, {3});
+    ASSERT_EQUAL((vector<int>{server.begin(), server.end()}), (vector<int>{3, 7, 10}));
+
+    server.RemoveDocument(7);
+    server.AddDocument(5, "white cat"s, DocumentStatus::ACTUAL, {4});
+    ASSERT_EQUAL_HINT((vector<int>{server.begin(), server.end()}), (vector<int>{3, 5, 10}), "Documents must be iterated in external id order"s);
+    ASSERT_EQUAL(server.GetDocumentCount(), 3);
+
+    const auto found_docs = server.FindTopDocuments("white cat"s);
+    ASSERT_EQUAL(found_docs.size(), 2u);
+    ASSERT_EQUAL_HINT(found_docs[0].id, 5, "Results must carry external ids"s);
+    ASSERT_EQUAL(found_docs[0].rating, 4);
+    ASSERT_EQUAL(found_docs[1].id, 10);
+    ASSERT(get<1>(server.MatchDocument("cat"s, 3)) == DocumentStatus::BANNED);
+
+    bool is_thrown = false;
+    try {
+        server.MatchDocument("cat"s, 7);
+    } catch (const out_of_range&) {
+        is_thrown = true;
+    }
+    ASSERT_HINT(is_thrown, "Removed documents must not be matched"s);
+    ASSERT_HINT(server.FindTopDocuments(execution::par, "dog"s).empty(), "Removed documents must not be found"s);
+}
+
+void TestRemovedDocumentCompaction() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 30, 5);
+    const auto texts = GenerateQueries(generator, dictionary, 400, 10);
+    const array statuses = {DocumentStatus::ACTUAL, DocumentStatus::ACTUAL, DocumentStatus::BANNED};
+
+    SearchServer server(""s);
+    server.SetImpactOrderThreshold(20);
+    server.SetTermTopDocumentsThreshold(20);
+    for (size_t i = 0; i < texts.size(); ++i) {
+        server.AddDocument(static_cast<int>(i), texts[i], statuses[i % statuses.size()], {static_cast<int>(i % 9)});
+    }
+    const auto get_documents_bytes = [](const SearchServer& server) {
+        const auto report = server.GetMemoryReport();
+        return find_if(report.structures.begin(), report.structures.end(), [](const StructureMemoryUsage& structure) {
+            return structure.name == "documents"s;
+        })->usage.bytes;
+    };
+    const size_t full_bytes = get_documents_bytes(server);
+
+    vector<int> document_ids(texts.size());
+    iota(document_ids.begin(), document_ids.end(), 0);
+    shuffle(document_ids.begin(), document_ids.end(), generator);
+    // Проверки попадают и между уплотнениями, когда в списках слов остаются записи удалённых документов
+    for (size_t removed = 0; removed < document_ids.size() * 3 / 4; removed += 37) {
+        for (size_t i = removed; i < min(removed + 37, document_ids.size()); ++i) {
+            server.RemoveDocument(document_ids[i]);
+        }
+        SearchServer expected(""s);
+        for (const int document_id : server) {
+            const auto document = static_cast<size_t>(document_id);
+            expected.AddDocument(document_id, texts[document], statuses[document % statuses.size()], {document_id % 9});
+        }
+        for (int i = 0; i < 10; ++i) {
+            const string query = GenerateQuery(generator, dictionary, 1 + i % 3, 0.2);
+            const auto found = server.FindTopDocuments(query);
+            const auto exact = expected.FindTopDocuments(query);
+            ASSERT_EQUAL_HINT(found.size(), exact.size(), query);
+            for (size_t j = 0; j < found.size(); ++j) {
+                ASSERT_EQUAL_HINT(found[j].id, exact[j].id, query);
+                ASSERT_HINT(abs(found[j].relevance - exact[j].relevance) < 1e-12, query);
+            }
+            const auto is_even = [](int document_id, DocumentStatus, int) {
+                return document_id % 2 == 0;
+            };
+            ASSERT_EQUAL_HINT(server.FindDocumentsPage(query, is_even, 0, texts.size()).documents.size(),
+                              expected.FindDocumentsPage(query, is_even, 0, texts.size()).documents.size(), query);
+            ASSERT_EQUAL_HINT(server.FindTopDocuments(execution::par, query, DocumentStatus::BANNED).size(),
+                              expected.FindTopDocuments(query, DocumentStatus::BANNED).size(), query);
+        }
+    }
+    ASSERT_HINT(get_documents_bytes(server) < full_bytes, "Compaction must release identifiers of removed documents"s);
+}
+
+void TestFindDocumentsByStatusBitmap() {
+    SearchServer server(""s);
+    server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "cat"s, DocumentStatus::BANNED, {2});
+    server.AddDocument(3, "cat"s, DocumentStatus::REMOVED, {3});
+    server.AddDocument(4, "cat"s, DocumentStatus::BANNED, {4});
+
+    const auto ids = [](const vector<Document>& documents) {
+        vector<int> result;
+        for (const auto& document : documents) {
+            result.push_back(document.id);
+        }
+        return result;
+    };
+    ASSERT_EQUAL(ids(server.FindTopDocuments("cat"s, DocumentStatus::BANNED)), (vector<int>{4, 2}));
+    ASSERT_EQUAL(ids(server.FindTopDocuments(execution::par, "cat"s, DocumentStatus::REMOVED)), (vector<int>{3}));
+    ASSERT(server.FindTopDocuments("cat"s, DocumentStatus::IRRELEVANT).empty());
+
+    server.RemoveDocument(4);
+    ASSERT_EQUAL_HINT(ids(server.FindTopDocuments("cat"s, DocumentStatus::BANNED)), (vector<int>{2}), "Removed documents must leave the status set"s);
+
+    const auto [documents, profile] = server.ExplainFindTopDocuments("cat"s);
+    ASSERT_EQUAL(ids(documents), (vector<int>{1}));
+    // Запись удалённого документа читается до уплотнения, но фильтр её отсекает
+    ASSERT(profile.execution == QueryExecution::DOCUMENT_AT_A_TIME);
+    ASSERT_EQUAL(profile.postings_visited, 4u);
+    ASSERT_EQUAL(profile.postings_accepted, 1u);
+
+    const auto by_predicate = server.FindTopDocuments("cat"s, [](int document_id, DocumentStatus status, int rating) {
+        return status != DocumentStatus::ACTUAL;
+    });
+    ASSERT_EQUAL_HINT(ids(by_predicate), (vector<int>{3, 2}), "Arbitrary predicates must keep working"s);
+}
+
+void TestFindDocumentsWithSearchFilter() {
+    SearchServer server(""s);
+    server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, {5});
+    server.AddDocument(3, "cat"s, DocumentStatus::BANNED, {3});
+    server.AddDocument(4, "cat"s, DocumentStatus::ACTUAL, {-2, -4});
+    server.AddDocument(5, "cat dog"s, DocumentStatus::IRRELEVANT, {4});
+
+    const auto ids = [](const vector<Document>& documents) {
+        vector<int> result;
+        for (const auto& document : documents) {
+            result.push_back(document.id);
+        }
+        return result;
+    };
+
+    ASSERT_EQUAL(ids(server.FindTopDocuments("cat"s, SearchFilter{})), (vector<int>{2, 1, 4}));
+
+    SearchFilter filter;
+    filter.min_rating = 1;
+    filter.max_rating = 4;
+    ASSERT_EQUAL_HINT(ids(server.FindTopDocuments("cat"s, filter)), (vector<int>{1}), "Rating bounds must be inclusive"s);
+
+    filter.statuses = {DocumentStatus::ACTUAL, DocumentStatus::BANNED, DocumentStatus::IRRELEVANT};
+    ASSERT_EQUAL(ids(server.FindTopDocuments(execution::par, "cat"s, filter)), (vector<int>{5, 3, 1}));
+
+    server.RemoveDocument(3);
+    ASSERT_EQUAL_HINT(ids(server.FindTopDocuments("cat"s, filter)), (vector<int>{5, 1}), "Removed documents must leave the rating index"s);
+
+    filter.statuses.clear();
+    ASSERT(server.FindTopDocuments("cat"s, filter).empty());
+}
+
+void TestConjunctiveQueryMode() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat and collar"s, DocumentStatus::ACTUAL, {8});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7});
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, {5});
+    server.AddDocument(4, "fluffy dog and fluffy cat"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(5, "fluffy cat"s, DocumentStatus::BANNED, {9});
+    for (int id = 6; id < 40; ++id) {
+        server.AddDocument(id, "cat tail"s, DocumentStatus::ACTUAL, {1});
+    }
+
+    const auto ids = [](const vector<Document>& documents) {
+        vector<int> result;
+        for (const auto& document : documents) {
+            result.push_back(document.id);
+        }
+        return result;
+    };
+
+    ASSERT_EQUAL(ids(server.FindTopDocuments("fluffy cat"s, QueryMode::CONJUNCTIVE)), (vector<int>{2, 4}));
+    ASSERT_EQUAL(ids(server.FindTopDocuments("fluffy cat -dog"s, QueryMode::CONJUNCTIVE)), (vector<int>{2}));
+    ASSERT_EQUAL(ids(server.FindTopDocuments("fluffy cat"s, QueryMode::CONJUNCTIVE, DocumentStatus::BANNED)), (vector<int>{5}));
+    ASSERT(server.FindTopDocuments("fluffy parrot"s, QueryMode::CONJUNCTIVE).empty());
+    ASSERT(server.FindTopDocuments("-cat"s, QueryMode::CONJUNCTIVE).empty());
+
+    const auto disjunctive = server.FindTopDocuments("fluffy tail"s);
+    const auto conjunctive = server.FindTopDocuments("fluffy tail"s, QueryMode::CONJUNCTIVE, [](int, DocumentStatus, int) {
+        return true;
+    });
+    ASSERT_EQUAL(ids(conjunctive), (vector<int>{2}));
+    ASSERT_EQUAL_HINT(conjunctive[0].relevance, disjunctive[0].relevance, "Both modes must score a document identically"s);
+
+    ASSERT_EQUAL(ids(server.FindTopDocuments("fluffy cat"s, QueryMode::DISJUNCTIVE)), ids(server.FindTopDocuments("fluffy cat"s)));
+}
+
+void TestQueryPlanner() {
+    {
+        QueryStatistics statistics;
+        statistics.plus_posting_counts = {500, 20, 0, 100};
+        statistics.document_count = 100'000;
+        const QueryPlan plan = PlanQuery(statistics);
+        ASSERT_HINT(plan.strategy == QueryStrategy::DOCUMENT_AT_A_TIME, "Short lists in a large index must not pay for a dense accumulator"s);
+        ASSERT(!plan.is_parallel);
+    }
+    {
+        QueryStatistics statistics;
+        statistics.plus_posting_counts = {50'000, 60'000, 70'000};
+        statistics.minus_posting_counts = {90'000};
+        statistics.document_count = 100'000;
+        statistics.thread_count = 1;
+        QueryPlan plan = PlanQuery(statistics);
+        ASSERT(plan.strategy == QueryStrategy::TERM_AT_A_TIME);
+        ASSERT_HINT(plan.prefilter_minus_words, "Minus words covering most documents must be applied before scoring"s);
+
+        statistics.plus_posting_counts = {20, 30};
+        ASSERT(PlanQuery(statistics).strategy == QueryStrategy::DOCUMENT_AT_A_TIME);
+        ASSERT_HINT(!PlanQuery(statistics).prefilter_minus_words, "The bitmap prefilter applies to term-at-a-time only"s);
+        statistics.plus_posting_counts = {50'000, 60'000, 70'000};
+        ASSERT_HINT(!PlanQuery(statistics).is_parallel, "A single thread must not split the lists"s);
+
+        statistics.plus_posting_counts = {5'000'000, 6'000'000, 7'000'000};
+        statistics.filter_selectivity = 0.01;
+        statistics.thread_count = 8;
+        plan = PlanQuery(statistics);
+        ASSERT_HINT(plan.is_parallel, "Long lists must be split between threads"s);
+    }
+
+    SearchServer server("and"s);
+    for (int id = 0; id < 300; ++id) {
+        const string rare = id % 50 == 0 ? " rare"s : ""s;
+        const string status_word = id % 3 == 0 ? " parrot"s : " dog"s;
+        server.AddDocument(id, "cat"s + rare + status_word + (id % 7 == 0 ? " fluffy"s : ""s), id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 11});
+    }
+    server.RemoveDocument(100);
+
+    ASSERT(server.GetQueryPlan("rare fluffy"s).strategy == QueryStrategy::DOCUMENT_AT_A_TIME);
+    ASSERT(server.GetQueryPlan("cat dog parrot"s).strategy == QueryStrategy::TERM_AT_A_TIME);
+
+    for (const string& query : {"rare fluffy"s, "rare fluffy -parrot"s, "cat dog parrot -fluffy"s, "cat -dog -parrot"s, "missing"s}) {
+        // Страница выдачи всегда считается по словам
+        const auto expected = server.FindDocumentsPage(query, 0, MAX_RESULT_DOCUMENT_COUNT).documents;
+        for (const auto& actual : {server.FindTopDocuments(execution_auto, query), server.FindTopDocuments(query), server.FindTopDocuments(execution::par, query)}) {
+            ASSERT_EQUAL_HINT(actual.size(), expected.size(), query);
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, query);
+                ASSERT_EQUAL_HINT(actual[i].relevance, expected[i].relevance, query);
+            }
+        }
+    }
+    const auto even = [](int document_id, DocumentStatus status, int rating) {
+        return document_id % 2 == 0;
+    };
+    ASSERT_EQUAL(server.FindTopDocuments(execution_auto, "rare fluffy"s, even).size(), server.FindTopDocuments(execution::seq, "rare fluffy"s, even).size());
+}
+
+void TestParallelSearchByDocumentRange() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 200, 6);
+    const auto documents = GenerateQueries(generator, dictionary, 5'000, 20);
+
+    SearchServer server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        server.AddDocument(static_cast<int>(i), documents[i], i % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {static_cast<int>(i % 10)});
+    }
+    for (int id = 0; id < 5'000; id += 7) {
+        server.RemoveDocument(id);
+    }
+
+    for (int i = 0; i < 20; ++i) {
+        const string query = GenerateQuery(generator, dictionary, 6, 0.3);
+        const auto expected = server.FindTopDocuments(execution::seq, query);
+        const auto actual = server.FindTopDocuments(execution::par, query);
+        ASSERT_EQUAL_HINT(actual.size(), expected.size(), query);
+        for (size_t j = 0; j < expected.size(); ++j) {
+            ASSERT_EQUAL_HINT(actual[j].id, expected[j].id, query);
+            ASSERT_HINT(abs(actual[j].relevance - expected[j].relevance) < TOLERANCE, query);
+        }
+
+        const auto banned = [](int document_id, DocumentStatus status, int rating) {
+            return status == DocumentStatus::BANNED && rating > 4;
+        };
+        ASSERT_EQUAL_HINT(server.FindTopDocuments(execution::par, query, banned).size(), server.FindTopDocuments(execution::seq, query, banned).size(), query);
+    }
+
+    // Длинные списки, на которых планировщик делит документы между потоками пула
+    SearchServer large_server(""s);
+    for (int id = 0; id < 40'000; ++id) {
+        string text = "word"s + to_string(id % 101);
+        for (const auto& [word, step] : {pair{"cat"s, 2}, pair{"dog"s, 3}, pair{"bird"s, 5}}) {
+            if (id % step == 0) {
+                text += " "s + word;
+            }
+        }
+        large_server.AddDocument(id, text, id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 13});
+    }
+    ThreadPool pool(4);
+    for (const string& query : {"cat dog bird"s, "cat dog bird -word7"s}) {
+        const auto expected = large_server.FindTopDocuments(execution::seq, query);
+        const auto actual = large_server.FindTopDocuments(pool, query);
+        ASSERT_EQUAL_HINT(actual.size(), expected.size(), query);
+        for (size_t j = 0; j < expected.size(); ++j) {
+            ASSERT_EQUAL_HINT(actual[j].id, expected[j].id, query);
+            ASSERT_HINT(abs(actual[j].relevance - expected[j].relevance) < TOLERANCE, query);
+        }
+    }
+}
+
+void TestThreadPool() {
+    ThreadPool pool(2);
+    ASSERT_EQUAL(pool.GetThreadCount(), 2u);
+    ASSERT(!pool.IsWorkerThread());
+    ASSERT_EQUAL(pool.Submit([] { return 42; }).get(), 42);
+
+    vector<atomic<int>> visits(1000);
+    pool.ParallelFor(0, visits.size(), [&visits, &pool](size_t index) {
+        // Вложенный вызов из рабочего потока не должен ни блокироваться, ни терять индексы
+        pool.ParallelFor(0, 3, [&visits, index](size_t) {
+            ++visits[index];
+        });
+    });
+    ASSERT(all_of(visits.begin(), visits.end(), [](const atomic<int>& count) {
+        return count.load() == 3;
+    }));
+
+    bool is_thrown = false;
+    try {
+        pool.ParallelFor(0, 100, [](size_t index) {
+            if (index == 57) {
+                throw runtime_error("failed"s);
+            }
+        });
+    } catch (const runtime_error&) {
+        is_thrown = true;
+    }
+    ASSERT_HINT(is_thrown, "Exceptions must reach the caller"s);
+
+    try {
+        ThreadPool pinned_pool(ThreadPool::Options{1, {-1}});
+        ASSERT_HINT(false, "Negative CPU index must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    ThreadPool pinned_pool(ThreadPool::Options{2, {0}});
+    ASSERT_EQUAL(pinned_pool.Submit([] { return 1; }).get(), 1);
+
+    SearchServer server("and"s);
+    const vector<string> texts = {"white cat and collar"s, "fluffy cat fluffy tail"s, "groomed dog expressive eyes"s, "fluffy dog"s};
+    for (size_t i = 0; i < texts.size(); ++i) {
+        server.AddDocument(static_cast<int>(i), texts[i], DocumentStatus::ACTUAL, {static_cast<int>(i)});
+    }
+    const vector<string> queries = {"fluffy cat"s, "dog -fluffy"s, "eyes collar"s};
+    const auto results = ProcessQueriesInPool(server, queries, pool);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = server.FindTopDocuments(queries[i]);
+        const auto actual = server.FindTopDocuments(pool, queries[i]);
+        ASSERT_EQUAL(actual.size(), expected.size());
+        ASSERT_EQUAL(results[i].size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j) {
+            ASSERT_EQUAL(actual[j].id, expected[j].id);
+            ASSERT_EQUAL(results[i][j].id, expected[j].id);
+        }
+    }
+
+    const auto [words, status] = server.MatchDocument(pool, "fluffy tail cat -dog"s, 1);
+    ASSERT_EQUAL(words, (vector<string_view>{"cat"sv, "fluffy"sv, "tail"sv}));
+    ASSERT(get<0>(server.MatchDocument(pool, "fluffy -dog"s, 3)).empty());
+
+    ThreadPool ingestion_pool(1);
+    server.RemoveDocument(ingestion_pool, 1);
+    ASSERT(server.FindTopDocuments(pool, "tail"s).empty());
+}
+
+void TestAsyncRequestQueue() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat and collar"s, DocumentStatus::ACTUAL, {8});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7});
+    server.AddDocument(3, "groomed dog"s, DocumentStatus::BANNED, {5});
+
+    ThreadPool pool(1);
+    {
+        promise<void> release;
+        const shared_future<void> released = release.get_future().share();
+        const auto wait_for_release = [released](int document_id, DocumentStatus status, int rating) {
+            released.wait();
+            return true;
+        };
+
+        AsyncRequestQueue queue(server, pool, 2);
+        auto blocked = queue.FindTopDocumentsAsync("cat"s, wait_for_release);
+        auto queued = queue.FindTopDocumentsAsync("dog"s, DocumentStatus::BANNED);
+        auto rejected = queue.FindTopDocumentsAsync("tail"s);
+        ASSERT_EQUAL(queue.GetRejectedCount(), 1u);
+        bool is_rejected = false;
+        try {
+            rejected.get();
+        } catch (const QueueFullError&) {
+            is_rejected = true;
+        }
+        ASSERT_HINT(is_rejected, "Requests over capacity must be shed immediately"s);
+
+        release.set_value();
+        ASSERT_EQUAL(blocked.get().size(), 2u);
+        ASSERT_EQUAL(queued.get()[0].id, 3);
+        ASSERT_EQUAL(queue.FindTopDocumentsAsync("tail"s).get()[0].id, 2);
+        ASSERT_EQUAL(queue.GetPendingCount(), 0u);
+    }
+    {
+        promise<void> release;
+        const shared_future<void> released = release.get_future().share();
+        AsyncRequestQueue queue(server, pool, 1, AsyncRequestQueue::OverflowPolicy::WAIT);
+        auto blocked = queue.FindTopDocumentsAsync("cat"s, [released](int document_id, DocumentStatus status, int rating) {
+            released.wait();
+            return true;
+        });
+        thread releaser([&release] {
+            this_thread::sleep_for(chrono::milliseconds(10));
+            release.set_value();
+        });
+        ASSERT_EQUAL_HINT(queue.FindTopDocumentsAsync("collar"s).get()[0].id, 1, "Waiting submission must be accepted once a slot is free"s);
+        releaser.join();
+        ASSERT_EQUAL(queue.GetRejectedCount(), 0u);
+        blocked.get();
+    }
+    {
+        // Единственный рабочий поток занимает единственное место и не может ждать, пока освободит его сам
+        AsyncRequestQueue queue(server, pool, 1, AsyncRequestQueue::OverflowPolicy::WAIT);
+        auto outer = queue.FindTopDocumentsAsync("cat"s, [&queue](int document_id, DocumentStatus status, int rating) {
+            return queue.FindTopDocumentsAsync("collar"s).get()[0].id == 1;
+        });
+        ASSERT_EQUAL_HINT(outer.get().size(), 2u, "A nested waiting submission from a pool worker must run inline"s);
+        ASSERT_EQUAL(queue.GetPendingCount(), 0u);
+    }
+}
+
+void TestFindTopDocumentsWithDeadline() {
+    SearchServer server("and"s);
+    for (int id = 0; id < 3'000; ++id) {
+        server.AddDocument(id, id % 10 == 0 ? "rare cat"s : "common cat"s, id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 7});
+    }
+
+    const auto expected = server.FindTopDocuments("rare common -cat"s);
+    auto unlimited = server.FindTopDocumentsWithDeadline("rare common -cat"s, SearchDeadline{});
+    ASSERT(!unlimited.is_partial);
+    ASSERT(unlimited.documents.empty() && expected.empty());
+
+    const auto full = server.FindTopDocuments("rare common"s);
+    unlimited = server.FindTopDocumentsWithDeadline("rare common"s, SearchDeadline{chrono::hours(1)});
+    ASSERT(!unlimited.is_partial);
+    ASSERT_EQUAL(unlimited.documents.size(), full.size());
+    for (size_t i = 0; i < full.size(); ++i) {
+        ASSERT_EQUAL(unlimited.documents[i].id, full[i].id);
+    }
+
+    const auto expired = server.FindTopDocumentsWithDeadline("rare common"s, SearchDeadline{SearchDeadline::Clock::now()});
+    ASSERT(expired.is_partial);
+    ASSERT(expired.documents.empty());
+
+    // Отмена посреди длинного списка: редкое слово уже подсчитано и попадает в неполную выдачу
+    CancellationToken token;
+    int calls = 0;
+    const auto cancelled = server.FindTopDocumentsWithDeadline("common rare"s, SearchDeadline{token},
+        [&token, &calls](int document_id, DocumentStatus status, int rating) {
+            if (++calls == 500) {
+                token.Cancel();
+            }
+            return status == DocumentStatus::ACTUAL;
+        });
+    ASSERT_HINT(cancelled.is_partial, "Cancellation must be noticed at the next posting block"s);
+    ASSERT(!cancelled.documents.empty());
+    ASSERT_HINT(calls < 3'000, "Scoring must stop early after cancellation"s);
+}
+
+void TestQuantizedImpacts() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 300, 6);
+    const auto texts = GenerateQueries(generator, dictionary, 2'000, 30);
+
+    SearchServer server(dictionary[0]);
+    for (size_t i = 0; i < texts.size(); ++i) {
+        server.AddDocument(static_cast<int>(i), texts[i], DocumentStatus::ACTUAL, {static_cast<int>(i % 10)});
+    }
+    ASSERT(server.GetQuantizedImpacts() == nullptr);
+
+    const auto find_structure = [](const IndexMemoryReport& report, const string& name) {
+        return find_if(report.structures.begin(), report.structures.end(), [&name](const StructureMemoryUsage& structure) {
+            return structure.name == name;
+        })->usage.bytes;
+    };
+
+    const int query_word_count = 5;
+    for (const auto precision : {ImpactPrecision::BITS_16, ImpactPrecision::BITS_8}) {
+        server.QuantizeImpacts(precision);
+        const auto* impacts = server.GetQuantizedImpacts();
+        ASSERT(impacts != nullptr);
+        // Ошибка каждого документа ограничена половиной шага квантования на слово запроса
+        const double max_error = query_word_count * impacts->GetMaxError();
+
+        for (int i = 0; i < 30; ++i) {
+            const string query = GenerateQuery(generator, dictionary, query_word_count, 0.2);
+            map<int, double> exact_relevance;
+            for (const auto& document : server.FindDocumentsPage(query, 0, texts.size()).documents) {
+                exact_relevance[document.id] = document.relevance;
+            }
+            const auto exact = server.FindTopDocuments(query);
+            const auto quantized = server.FindTopDocuments(execution_quantized, query);
+            ASSERT_EQUAL_HINT(quantized.size(), exact.size(), query);
+            for (size_t j = 0; j < quantized.size(); ++j) {
+                ASSERT_HINT(exact_relevance.count(quantized[j].id) > 0, query);
+                ASSERT_HINT(abs(quantized[j].relevance - exact_relevance[quantized[j].id]) <= max_error, query);
+                ASSERT_HINT(abs(quantized[j].relevance - exact[j].relevance) <= max_error + TOLERANCE, query);
+            }
+        }
+
+        const auto report = server.GetMemoryReport();
+        ASSERT_HINT(find_structure(report, "quantized_impacts"s) * 2 < find_structure(report, "term_postings"s),
+                    "Quantized postings must be much smaller than exact ones"s);
+    }
+
+    server.AddDocument(10'000, dictionary[1], DocumentStatus::ACTUAL, {1});
+    ASSERT_HINT(server.GetQuantizedImpacts() == nullptr, "Any modification must drop the snapshot"s);
+    const auto exact = server.FindTopDocuments(dictionary[1]);
+    const auto fallback = server.FindTopDocuments(execution_quantized, dictionary[1]);
+    ASSERT_EQUAL(fallback.size(), exact.size());
+    for (size_t i = 0; i < exact.size(); ++i) {
+        ASSERT_EQUAL(fallback[i].id, exact[i].id);
+        ASSERT_EQUAL(fallback[i].relevance, exact[i].relevance);
+    }
+}
+
+void TestImpactOrderedSearch() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 50, 5);
+    const auto texts = GenerateQueries(generator, dictionary, 2'000, 30);
+
+    SearchServer server(dictionary[0]);
+    for (size_t i = 0; i < texts.size(); ++i) {
+        server.AddDocument(static_cast<int>(i), texts[i], DocumentStatus::ACTUAL, {static_cast<int>(i % 10)});
+    }
+    const auto is_even = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0;
+    };
+    const auto check_queries = [&server, &dictionary, &is_even](mt19937& generator) {
+        for (int i = 0; i < 30; ++i) {
+            string query = GenerateQuery(generator, dictionary, 1 + i % 2);
+            if (i % 3 == 0) {
+                query += " -"s + dictionary[uniform_int_distribution<size_t>(1, dictionary.size() - 1)(generator)];
+            }
+            const auto exact = server.FindDocumentsPage(query, is_even, 0, MAX_RESULT_DOCUMENT_COUNT).documents;
+            const auto found = server.FindTopDocuments(query, is_even);
+            ASSERT_EQUAL_HINT(found.size(), exact.size(), query);
+            for (size_t j = 0; j < found.size(); ++j) {
+                ASSERT_EQUAL_HINT(found[j].id, exact[j].id, query);
+                ASSERT_EQUAL_HINT(found[j].relevance, exact[j].relevance, query);
+            }
+        }
+    };
+
+    const auto get_impact_index_bytes = [&server] {
+        const auto report = server.GetMemoryReport();
+        return find_if(report.structures.begin(), report.structures.end(), [](const StructureMemoryUsage& structure) {
+            return structure.name == "impact_ordered_postings"s;
+        })->usage.bytes;
+    };
+    // По умолчанию второй копии списков нет
+    ASSERT_EQUAL(get_impact_index_bytes(), 0u);
+
+    server.SetImpactOrderThreshold(100);
+    ASSERT(get_impact_index_bytes() > 0);
+    check_queries(generator);
+
+    for (int document_id = 0; document_id < 1'000; document_id += 3) {
+        server.RemoveDocument(document_id);
+    }
+    for (int document_id = 2'000; document_id < 2'300; ++document_id) {
+        server.AddDocument(document_id, GenerateQuery(generator, dictionary, 30), DocumentStatus::ACTUAL, {document_id % 10});
+    }
+    check_queries(generator);
+
+    const string& popular_word = dictionary[1];
+    const size_t posting_count = server.FindDocumentsPage(popular_word, 0, texts.size()).documents.size();
+    size_t predicate_calls = 0;
+    const auto counting_predicate = [&predicate_calls](int, DocumentStatus status, int) {
+        ++predicate_calls;
+        return status == DocumentStatus::ACTUAL;
+    };
+    ASSERT_EQUAL(server.FindTopDocuments(popular_word, counting_predicate).size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    ASSERT_HINT(predicate_calls * 2 < posting_count, "Single-word query must stop early"s);
+
+    server.SetImpactOrderThreshold(0);
+    ASSERT_EQUAL(get_impact_index_bytes(), 0u);
+    check_queries(generator);
+}
+
+void TestTermTopDocuments() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 40, 5);
+    const auto texts = GenerateQueries(generator, dictionary, 1'500, 20);
+    const array statuses = {DocumentStatus::ACTUAL, DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED};
+
+    SearchServer server(dictionary[0]);
+    server.SetTermTopDocumentsThreshold(50);
+    for (size_t i = 0; i < texts.size(); ++i) {
+        server.AddDocument(static_cast<int>(i), texts[i], statuses[i % statuses.size()], {static_cast<int>(i % 7)});
+    }
+    const auto check_queries = [&server, &dictionary, &statuses](mt19937& generator) {
+        for (int i = 0; i < 40; ++i) {
+            string query = dictionary[uniform_int_distribution<size_t>(1, dictionary.size() - 1)(generator)];
+            if (i % 4 == 0) {
+                query += " -"s + dictionary[uniform_int_distribution<size_t>(1, dictionary.size() - 1)(generator)];
+            }
+            const DocumentStatus status = statuses[i % statuses.size()];
+            const auto exact = server.FindDocumentsPage(query, [status](int, DocumentStatus document_status, int) {
+                return document_status == status;
+            }, 0, MAX_RESULT_DOCUMENT_COUNT).documents;
+            const auto found = server.FindTopDocuments(query, status);
+            ASSERT_EQUAL_HINT(found.size(), exact.size(), query);
+            for (size_t j = 0; j < found.size(); ++j) {
+                ASSERT_EQUAL_HINT(found[j].id, exact[j].id, query);
+                ASSERT_EQUAL_HINT(found[j].relevance, exact[j].relevance, query);
+            }
+        }
+    };
+    check_queries(generator);
+
+    // Удаление лучших документов заставляет отбирать их заново из полного списка
+    for (int round = 0; round < 3; ++round) {
+        for (const auto& word : dictionary) {
+            for (const auto& document : server.FindTopDocuments(word)) {
+                server.RemoveDocument(document.id);
+            }
+        }
+        check_queries(generator);
+    }
+    // Документы, перешедшие в поредевшие списки, не должны обгонять неотобранные
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); document_id += 3) {
+        if (!server.GetWordFrequencies(document_id).empty()) {
+            server.UpdateDocument(document_id, statuses[(document_id + 1) % statuses.size()], {document_id % 5});
+        }
+    }
+    check_queries(generator);
+    for (int document_id = 10'000; document_id < 10'200; ++document_id) {
+        server.AddDocument(document_id, GenerateQuery(generator, dictionary, 3), statuses[document_id % statuses.size()], {document_id % 7});
+    }
+    check_queries(generator);
+
+    const auto get_top_documents_bytes = [&server] {
+        const auto report = server.GetMemoryReport();
+        return find_if(report.structures.begin(), report.structures.end(), [](const StructureMemoryUsage& structure) {
+            return structure.name == "term_top_documents"s;
+        })->usage.bytes;
+    };
+    ASSERT(get_top_documents_bytes() > 0);
+
+    server.SetTermTopDocumentsThreshold(0);
+    ASSERT_EQUAL(get_top_documents_bytes(), 0u);
+    check_queries(generator);
+
+    // По умолчанию списки не строятся даже для самых частых слов
+    SearchServer default_server(dictionary[0]);
+    for (size_t i = 0; i < texts.size(); ++i) {
+        default_server.AddDocument(static_cast<int>(i), texts[i], DocumentStatus::ACTUAL, {1});
+    }
+    const auto [documents, profile] = default_server.ExplainFindTopDocuments(dictionary[1]);
+    ASSERT(profile.execution != QueryExecution::TERM_TOP_DOCUMENTS);
+    ASSERT(!documents.empty());
+}
+
+void TestStopWordSet() {
+    ASSERT(!StopWordSet{}.Contains("cat"s));
+    ASSERT(!StopWordSet(vector<string>{""s}).Contains(""s));
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 3'000, 8);
+    const vector<string> stop_words(dictionary.begin(), dictionary.begin() + dictionary.size() / 2);
+    vector<string> words_with_duplicates = stop_words;
+    words_with_duplicates.push_back(stop_words.front());
+    words_with_duplicates.push_back(""s);
+    const StopWordSet stop_word_set(words_with_duplicates);
+
+    ASSERT_EQUAL(stop_word_set.size(), stop_words.size());
+    for (const auto& word : stop_words) {
+        ASSERT_HINT(stop_word_set.Contains(word), word);
+        ASSERT_HINT(!stop_word_set.Contains(word + "X"s), word);
+        ASSERT_HINT(!stop_word_set.Contains("X"s + word), word);
+    }
+    for (size_t i = stop_words.size(); i < dictionary.size(); ++i) {
+        ASSERT_HINT(!stop_word_set.Contains(dictionary[i]), dictionary[i]);
+    }
+    ASSERT(stop_word_set.GetMemoryUsage().bytes > 0);
+
+    SearchServer server(stop_words);
+    server.AddDocument(1, stop_words[0] + " "s + dictionary.back(), DocumentStatus::ACTUAL, {1});
+    ASSERT(server.FindTopDocuments(stop_words[0]).empty());
+    ASSERT_EQUAL(server.FindTopDocuments(dictionary.back()).size(), 1u);
+    const auto [words, status] = server.MatchDocument(dictionary.back() + " "s + stop_words[1], 1);
+    ASSERT_EQUAL(words.size(), 1u);
+}
+
+#if defined(__linux__)
+void TestDurableSearchServer() {
+    namespace fs = std::filesystem;
+
+    const fs::path directory = fs::temp_directory_path() / ("search-server-wal-test-"s + to_string(chrono::steady_clock::now().time_since_epoch().count()));
+    fs::remove_all(directory);
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 200, 6);
+    SearchServer expected(dictionary[0]);
+    const auto check_recovered = [&directory, &dictionary, &expected](mt19937& generator) {
+        const DurableSearchServer recovered(directory, "ignored"s);
+        ASSERT_EQUAL(recovered.GetServer().GetDocumentCount(), expected.GetDocumentCount());
+        for (int i = 0; i < 20; ++i) {
+            const string query = GenerateQuery(generator, dictionary, 3, 0.2);
+            const auto expected_documents = expected.FindTopDocuments(query);
+            const auto documents = recovered.GetServer().FindTopDocuments(query);
+            ASSERT_EQUAL_HINT(documents.size(), expected_documents.size(), query);
+            for (size_t j = 0; j < documents.size(); ++j) {
+                ASSERT_EQUAL_HINT(documents[j].id, expected_documents[j].id, query);
+                ASSERT_EQUAL_HINT(documents[j].relevance, expected_documents[j].relevance, query);
+                ASSERT_EQUAL_HINT(documents[j].rating, expected_documents[j].rating, query);
+            }
+        }
+    };
+    const auto count_segments = [&directory] {
+        return count_if(fs::directory_iterator(directory), fs::directory_iterator(), [](const fs::directory_entry& entry) {
+            return entry.path().filename().string().rfind("wal-"s, 0) == 0;
+        });
+    };
+
+    DurableSearchServer::Options options;
+    options.checkpoint_log_size = 0;
+    int next_id = 0;
+    const auto add_documents = [&](DurableSearchServer& server, int count) {
+        for (int i = 0; i < count; ++i, ++next_id) {
+            const string text = GenerateQuery(generator, dictionary, 10);
+            const DocumentStatus status = next_id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+            const vector<int> ratings = {next_id % 7, -next_id % 3};
+            server.AddDocument(next_id, text, status, ratings);
+            expected.AddDocument(next_id, text, status, ratings);
+        }
+        for (int id = next_id - count; id < next_id; id += 4) {
+            server.RemoveDocument(id);
+            expected.RemoveDocument(id);
+        }
+    };
+
+    {
+        DurableSearchServer server(directory, dictionary[0], options);
+        add_documents(server, 300);
+    }
+    check_recovered(generator);
+
+    {
+        DurableSearchServer server(directory, dictionary[0], options);
+        for (int id = 1; id < next_id; id += 4) {
+            const string text = GenerateQuery(generator, dictionary, 10);
+            server.UpdateDocument(id, text, DocumentStatus::ACTUAL, {id});
+            expected.UpdateDocument(id, text, DocumentStatus::ACTUAL, {id});
+            server.UpdateDocument(id + 1, DocumentStatus::BANNED, {-id});
+            expected.UpdateDocument(id + 1, DocumentStatus::BANNED, {-id});
+        }
+    }
+    check_recovered(generator);
+
+    {
+        DurableSearchServer server(directory, dictionary[0], options);
+        add_documents(server, 100);
+        server.Checkpoint();
+        ASSERT_EQUAL(count_segments(), 1);
+        add_documents(server, 100);
+        server.Sync();
+    }
+    check_recovered(generator);
+
+    // Кадр, оборванный сбоем, отбрасывается
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        if (entry.path().filename().string().rfind("wal-"s, 0) == 0) {
+            ofstream(entry.path(), ios::binary | ios::app) << "\x10\x00\x00"s;
+        }
+    }
+    check_recovered(generator);
+
+    // Пакет после последнего fdatasync мог записаться не по порядку: нулевой кадр перед целым
+    // отбрасывается вместе со всем, что за ним, как и оборванный
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        if (entry.path().filename().string().rfind("wal-"s, 0) == 0 && entry.file_size() > 0) {
+            ifstream input(entry.path(), ios::binary);
+            const string data{istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+            input.close();
+            ofstream(entry.path(), ios::binary | ios::app) << string(12, '\0') << data;
+        }
+    }
+    check_recovered(generator);
+
+    {
+        options.sync_each_operation = true;
+        options.checkpoint_log_size = 4096;
+        DurableSearchServer server(directory, dictionary[0], options);
+        vector<thread> writers;
+        for (int thread_index = 0; thread_index < 4; ++thread_index) {
+            writers.emplace_back([&server, &dictionary, thread_index] {
+                for (int i = 0; i < 50; ++i) {
+                    server.AddDocument(100'000 + thread_index * 1'000 + i, dictionary[(thread_index + i) % dictionary.size()], DocumentStatus::ACTUAL, {i});
+                }
+            });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+        ASSERT_EQUAL(server.GetServer().GetDocumentCount(), expected.GetDocumentCount() + 200);
+    }
+    ASSERT_EQUAL(DurableSearchServer(directory, ""s).GetServer().GetDocumentCount(), expected.GetDocumentCount() + 200);
+
+    // Повреждение перед другими записями журнала останавливает восстановление, а не обрезает журнал
+    const fs::path corrupted_directory = directory / "corrupted"s;
+    {
+        DurableSearchServer server(corrupted_directory, dictionary[0], options);
+        for (int id = 0; id < 20; ++id) {
+            server.AddDocument(id, dictionary[id + 1], DocumentStatus::ACTUAL, {id});
+        }
+    }
+    for (const auto& entry : fs::directory_iterator(corrupted_directory)) {
+        if (entry.path().filename().string().rfind("wal-"s, 0) == 0 && entry.file_size() > 0) {
+            // Последний байт первого кадра: длина кадра — первые 4 байта в little-endian
+            fstream segment(entry.path(), ios::binary | ios::in | ios::out);
+            array<unsigned char, 4> body_size{};
+            segment.read(reinterpret_cast<char*>(body_size.data()), body_size.size());
+            segment.seekp(8 + body_size[0] + (body_size[1] << 8) - 1);
+            segment.put('\xff');
+        }
+    }
+    try {
+        DurableSearchServer recovered(corrupted_directory, ""s);
+        ASSERT_HINT(false, "Log corrupted in the middle must not be recovered"s);
+    } catch (const CorruptedDataError&) {
+    }
+
+    // Целая запись с идентификатором вне диапазона int не усекается молча
+    const fs::path out_of_range_directory = directory / "out-of-range"s;
+    fs::create_directories(out_of_range_directory);
+    {
+        WriteAheadLog log(out_of_range_directory, 1, {});
+        string record(1, '\x02'); // удаление документа
+        PutSignedVarint(record, int64_t{1} << 40);
+        log.Append(record);
+    }
+    try {
+        DurableSearchServer recovered(out_of_range_directory, ""s);
+        ASSERT_HINT(false, "Document id out of int range must be rejected"s);
+    } catch (const CorruptedDataError&) {
+    }
+
+    try {
+        SearchServer::Deserialize(expected.Serialize().substr(1));
+        ASSERT_HINT(false, "Corrupted index must not be loaded"s);
+    } catch (const CorruptedDataError&) {
+    }
+    fs::remove_all(directory);
+}
+
+void TestLoadCorpus() {
+    namespace fs = std::filesystem;
+
+    const fs::path path = fs::temp_directory_path() / ("search-server-corpus-test-"s + to_string(chrono::steady_clock::now().time_since_epoch().count()));
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 100, 6);
+
+    SearchServer expected("and in"s);
+    {
+        ofstream output(path, ios::binary);
+        for (int id = 0; id < 500; ++id) {
+            const string text = GenerateQuery(generator, dictionary, 1 + id % 9);
+            const DocumentStatus status = static_cast<DocumentStatus>(id % DOCUMENT_STATUS_COUNT);
+            const vector<int> ratings = id % 4 == 0 ? vector<int>{} : vector<int>{id % 5, -(id % 3)};
+            expected.AddDocument(id, text, status, ratings);
+
+            output << id << '\t';
+            if (id % 2 == 0) {
+                output << static_cast<int>(status);
+            } else {
+                output << array{"ACTUAL"s, "IRRELEVANT"s, "BANNED"s, "REMOVED"s}[static_cast<int>(status)];
+            }
+            output << '\t';
+            for (size_t i = 0; i < ratings.size(); ++i) {
+                output << (i > 0 ? ","s : ""s) << ratings[i];
+            }
+            output << '\t' << text << (id % 7 == 0 ? "\r\n"s : "\n"s);
+            if (id % 50 == 0) {
+                output << '\n';
+            }
+        }
+        // Последняя строка без перевода строки
+        output << "1000\tACTUAL\t\tlast";
+    }
+    expected.AddDocument(1000, "last"s, DocumentStatus::ACTUAL, {});
+
+    for (const size_t chunk_size : {size_t{1}, size_t{100}, size_t{1} << 20}) {
+        SearchServer loaded("and in"s);
+        CorpusLoadOptions options;
+        options.chunk_size = chunk_size;
+        options.chunks_in_flight = 3;
+        ASSERT_EQUAL(LoadCorpus(path, loaded, options), 501u);
+        ASSERT_EQUAL(loaded.GetDocumentCount(), expected.GetDocumentCount());
+        for (const int id : expected) {
+            const auto [words, status] = loaded.MatchDocument(dictionary[id % dictionary.size()] + " last"s, id);
+            const auto [expected_words, expected_status] = expected.MatchDocument(dictionary[id % dictionary.size()] + " last"s, id);
+            ASSERT(words == expected_words);
+            ASSERT(status == expected_status);
+        }
+        for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+            const string query = GenerateQuery(generator, dictionary, 3);
+            const auto documents = loaded.FindTopDocuments(query, status);
+            const auto expected_documents = expected.FindTopDocuments(query, status);
+            ASSERT_EQUAL_HINT(documents.size(), expected_documents.size(), query);
+            for (size_t i = 0; i < documents.size(); ++i) {
+                ASSERT_EQUAL_HINT(documents[i].id, expected_documents[i].id, query);
+                ASSERT_EQUAL_HINT(documents[i].rating, expected_documents[i].rating, query);
+            }
+        }
+    }
+
+    ofstream(path, ios::binary | ios::app) << "\n\n7\tUNKNOWN\t1\tbad status\n"s;
+    size_t consumed = 0;
+    try {
+        LoadCorpus(path, [&consumed](const CorpusDocument&) {
+            ++consumed;
+        }, ThreadPool::GetDefault(), CorpusLoadOptions{64, 4});
+        ASSERT_HINT(false, "Malformed line must be reported"s);
+    } catch (const invalid_argument& e) {
+        ASSERT_HINT(string(e.what()).find("line 513"s) != string::npos, e.what());
+    }
+    ASSERT_EQUAL(consumed, 501u);
+
+    fs::remove(path);
+    try {
+        LoadCorpus(path, expected);
+        ASSERT_HINT(false, "Missing corpus must be reported"s);
+    } catch (const system_error&) {
+    }
+}
+
+void TestQuerySocketServer() {
+    namespace fs = std::filesystem;
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 200, 5);
+    SearchServer search_server("and in"s);
+    for (int id = 0; id < 300; ++id) {
+        search_server.AddDocument(id, GenerateQuery(generator, dictionary, 8), DocumentStatus::ACTUAL, {id % 7, -(id % 3)});
+    }
+    auto queries = GenerateQueries(generator, dictionary, 100, 3);
+    queries[40] = "cat --dog"s;
+
+    ASSERT_EQUAL(FormatQueryResponse({}), "OK"s);
+    ASSERT_EQUAL(FormatQueryResponse({{3, 0.5, -2}, {7, 0.25, 4}}), "OK 3:0.5:-2 7:0.25:4"s);
+
+    // Все запросы отправляются сразу, ответы читаются после закрытия передачи; возвращает число пакетов
+    const auto check_session = [&search_server, &queries](const QuerySocketServer::Options& options) {
+        const fs::path path = fs::temp_directory_path() / ("search-server-socket-test-"s + to_string(chrono::steady_clock::now().time_since_epoch().count()));
+        ThreadPool pool(4);
+        QuerySocketServer server(search_server, pool, options);
+        server.ListenUnix(path.string());
+        thread server_thread([&server] {
+            server.Run();
+        });
+
+        const int client = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        path.string().copy(address.sun_path, sizeof(address.sun_path) - 1);
+        ASSERT(connect(client, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0);
+
+        string request;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            request += queries[i] + (i % 2 == 0 ? "\n"s : "\r\n"s);
+        }
+        for (size_t written = 0; written < request.size();) {
+            const ssize_t size = send(client, request.data() + written, request.size() - written, 0);
+            ASSERT(size > 0);
+            written += static_cast<size_t>(size);
+        }
+        shutdown(client, SHUT_WR);
+        string response;
+        char buffer[4096];
+        for (ssize_t size; (size = recv(client, buffer, sizeof(buffer), 0)) > 0;) {
+            response.append(buffer, static_cast<size_t>(size));
+        }
+        close(client);
+
+        server.Stop();
+        server_thread.join();
+
+        vector<string> lines;
+        for (size_t begin = 0, end; (end = response.find('\n', begin)) != string::npos; begin = end + 1) {
+            lines.push_back(response.substr(begin, end - begin));
+        }
+        ASSERT_EQUAL(lines.size(), queries.size());
+        for (size_t i = 0; i < queries.size(); ++i) {
+            if (i == 40) {
+                ASSERT_HINT(lines[i].rfind("ERROR "s, 0) == 0, lines[i]);
+            } else {
+                ASSERT_EQUAL_HINT(lines[i], FormatQueryResponse(search_server.FindTopDocuments(queries[i])), queries[i]);
+            }
+        }
+        ASSERT_EQUAL(server.GetRequestCount(), queries.size());
+        return server.GetBatchCount();
+    };
+
+    QuerySocketServer::Options options;
+    options.batch_delay = chrono::milliseconds(20);
+    ASSERT(check_session(options) < queries.size());
+
+    // Клиент, упёршийся в ограничения, читается снова, когда ответы ему уходят
+    options.batch_delay = chrono::microseconds(0);
+    options.max_pending_requests = 3;
+    options.max_output_size = 256;
+    ASSERT(check_session(options) >= queries.size() / 3);
+}
+
+#endif
+
+void TestShardedSearchServer() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 300, 5);
+    const auto queries = GenerateQueries(generator, dictionary, 200, 4);
+
+    ThreadPool pool(3);
+    SearchServer single("and in"s);
+    ShardedSearchServer sharded(4, "and in"s, pool);
+    for (int id = 0; id < 2000; ++id) {
+        const string text = GenerateQuery(generator, dictionary, 3 + id % 10);
+        const DocumentStatus status = static_cast<DocumentStatus>(id % 3 == 0 ? id % DOCUMENT_STATUS_COUNT : 0);
+        const vector<int> ratings = {id % 9, -(id % 4)};
+        single.AddDocument(id, text, status, ratings);
+        sharded.AddDocument(id, text, status, ratings);
+    }
+    ASSERT_EQUAL(sharded.GetDocumentCount(), single.GetDocumentCount());
+    for (size_t i = 0; i < sharded.GetShardCount(); ++i) {
+        ASSERT(sharded.GetShard(i).GetDocumentCount() > 0);
+    }
+
+    const auto check_queries = [&](const string& hint) {
+        const auto is_odd = [](int document_id, DocumentStatus, int) {
+            return document_id % 2 == 1;
+        };
+        for (const string& query : queries) {
+            const vector<pair<vector<Document>, vector<Document>>> results = {
+                {single.FindTopDocuments(query), sharded.FindTopDocuments(query)},
+                {single.FindTopDocuments(query, DocumentStatus::BANNED), sharded.FindTopDocuments(query, DocumentStatus::BANNED)},
+                {single.FindTopDocuments(query, is_odd), sharded.FindTopDocuments(query, is_odd)},
+            };
+            for (const auto& [expected, actual] : results) {
+                ASSERT_EQUAL_HINT(actual.size(), expected.size(), hint + query);
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, hint + query);
+                    ASSERT_HINT(abs(actual[i].relevance - expected[i].relevance) < TOLERANCE, hint + query);
+                    ASSERT_EQUAL_HINT(actual[i].rating, expected[i].rating, hint + query);
+                }
+            }
+        }
+    };
+    check_queries("added: "s);
+
+    for (int id = 0; id < 2000; id += 3) {
+        single.RemoveDocument(id);
+        sharded.RemoveDocument(id);
+    }
+    ASSERT_EQUAL(sharded.GetDocumentCount(), single.GetDocumentCount());
+    check_queries("removed: "s);
+
+    const string query = queries.front() + " -"s + queries.back().substr(0, queries.back().find(' '));
+    ASSERT(sharded.MatchDocument(query, 1) == single.MatchDocument(query, 1));
+    try {
+        sharded.AddDocument(1, "duplicate"s, DocumentStatus::ACTUAL, {});
+        ASSERT_HINT(false, "Duplicate id must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    try {
+        sharded.GetShard(0).FindTopDocumentsWithStatistics("one two"s, sharded.GetShard(0).GetCorpusStatistics("one"s));
+        ASSERT_HINT(false, "Statistics of another query must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestConcurrentMap() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 5000, 8);
+    vector<string> words;
+    for (int i = 0; i < 100000; ++i) {
+        words.push_back(dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)]);
+    }
+    map<string, int> expected;
+    for (const string& word : words) {
+        ++expected[word];
+    }
+
+    ThreadPool pool(4);
+    ConcurrentMap<string, int> counts(16);
+    pool.ParallelFor(0, words.size(), [&counts, &words](size_t index) {
+        counts.FetchAdd(words[index], 1);
+    });
+    ASSERT_EQUAL(counts.size(), expected.size());
+    ASSERT(counts.BuildOrdinaryMap() == expected);
+    atomic<int> total = 0;
+    counts.ForEach(pool, [&total](const string&, int count) {
+        total += count;
+    });
+    ASSERT_EQUAL(total.load(), static_cast<int>(words.size()));
+
+    // Удаление сдвигает цепочки пробирования: оставшиеся ключи должны находиться
+    ConcurrentMap<int, int> numbers(1);
+    for (int i = 0; i < 1000; ++i) {
+        numbers[i * 7].ref_to_value = i;
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        numbers.erase(i * 7);
+    }
+    numbers.erase(-1);
+    ASSERT_EQUAL(numbers.size(), 500u);
+    for (int i = 0; i < 1000; ++i) {
+        const auto value = numbers.Find(i * 7);
+        ASSERT_EQUAL_HINT(value.has_value(), i % 2 == 1, to_string(i));
+        if (value) {
+            ASSERT_EQUAL(*value, i);
+        }
+    }
+    ASSERT_EQUAL(numbers.FetchAdd(7, 5), 1);
+    ASSERT_EQUAL(*numbers.Find(7), 6);
+
+    try {
+        ConcurrentMap<int, int> empty(0);
+        ASSERT_HINT(false, "Zero bucket count must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestReorderDocuments() {
+    mt19937 generator;
+    // Документы из нескольких тем со своими словами, добавленные вперемешку
+    vector<vector<string>> topics;
+    for (int topic = 0; topic < 8; ++topic) {
+        topics.push_back(GenerateDictionary(generator, 60, 6));
+    }
+    vector<string> texts;
+    SearchServer search_server("and in"s);
+    search_server.SetImpactOrderThreshold(50);
+    search_server.SetTermTopDocumentsThreshold(50);
+    for (int id = 0; id < 3000; ++id) {
+        texts.push_back(GenerateQuery(generator, topics[uniform_int_distribution<size_t>(0, topics.size() - 1)(generator)], 8));
+        search_server.AddDocument(id * 3, texts.back(), static_cast<DocumentStatus>(id % 5 == 0 ? id % DOCUMENT_STATUS_COUNT : 0), {id % 11 - 5});
+    }
+    for (int id = 0; id < 3000; id += 7) {
+        search_server.RemoveDocument(id * 3);
+    }
+
+    vector<string> queries;
+    for (int i = 0; i < 100; ++i) {
+        queries.push_back(GenerateQuery(generator, topics[i % topics.size()], 1 + i % 3, i % 4 == 0 ? 0.3 : 0.0));
+    }
+    SearchFilter filter;
+    filter.statuses = {DocumentStatus::ACTUAL, DocumentStatus::BANNED};
+    filter.min_rating = -2;
+    filter.max_rating = 3;
+    const auto search_all = [&] {
+        vector<vector<Document>> results;
+        for (const string& query : queries) {
+            results.push_back(search_server.FindTopDocuments(query));
+            results.push_back(search_server.FindTopDocuments(query, DocumentStatus::BANNED));
+            results.push_back(search_server.FindTopDocuments(query, filter));
+            results.push_back(search_server.FindTopDocuments(query, QueryMode::CONJUNCTIVE));
+        }
+        return results;
+    };
+    const auto expected = search_all();
+    const int document_count = search_server.GetDocumentCount();
+    const auto matched = search_server.MatchDocument(queries.front(), 3);
+    const auto get_word_freqs = [&search_server](int document_id) {
+        const auto word_freqs = search_server.GetWordFrequencies(document_id);
+        return map<string_view, double>(word_freqs.begin(), word_freqs.end());
+    };
+    const auto word_freqs = get_word_freqs(6);
+
+    const DocumentReorderingReport report = search_server.ReorderDocuments();
+    ASSERT_EQUAL(report.document_count, static_cast<size_t>(document_count));
+    ASSERT_HINT(report.encoded_size_after < report.encoded_size_before,
+                to_string(report.encoded_size_before) + " -> "s + to_string(report.encoded_size_after));
+    ASSERT(report.GetCompressionRatioAfter() > report.GetCompressionRatioBefore());
+
+    ASSERT_EQUAL(search_server.GetDocumentCount(), document_count);
+    ASSERT(search_server.MatchDocument(queries.front(), 3) == matched);
+    const auto actual = search_all();
+    ASSERT_EQUAL(actual.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL_HINT(actual[i].size(), expected[i].size(), queries[i / 4]);
+        for (size_t j = 0; j < expected[i].size(); ++j) {
+            ASSERT_EQUAL_HINT(actual[i][j].id, expected[i][j].id, queries[i / 4]);
+            ASSERT_HINT(abs(actual[i][j].relevance - expected[i][j].relevance) < TOLERANCE, queries[i / 4]);
+        }
+    }
+    ASSERT(get_word_freqs(6) == word_freqs);
+
+    // Сервер остаётся изменяемым после перенумерации
+    search_server.RemoveDocument(6);
+    search_server.AddDocument(1, texts[2], DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(search_server.GetDocumentCount(), document_count);
+    ASSERT(get_word_freqs(1) == word_freqs);
+}
+
+void TestUpdateDocument() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 150, 5);
+    // updated меняет документы на месте, rebuilt — удалением и повторным добавлением
+    SearchServer updated("and in"s);
+    SearchServer rebuilt("and in"s);
+    for (SearchServer* server : {&updated, &rebuilt}) {
+        server->SetImpactOrderThreshold(30);
+        server->SetTermTopDocumentsThreshold(30);
+    }
+    vector<vector<string>> texts;
+    vector<DocumentStatus> statuses;
+    vector<vector<int>> ratings;
+    const auto join = [](const vector<string>& words) {
+        string text;
+        for (const string& word : words) {
+            text += (text.empty() ? ""s : " "s) + word;
+        }
+        return text;
+    };
+    for (int id = 0; id < 400; ++id) {
+        texts.emplace_back();
+        for (int i = 0; i < 5 + id % 40; ++i) {
+            texts.back().push_back(dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)]);
+        }
+        statuses.push_back(static_cast<DocumentStatus>(id % DOCUMENT_STATUS_COUNT));
+        ratings.push_back({id % 10 - 3});
+        updated.AddDocument(id, join(texts.back()), statuses.back(), ratings.back());
+        rebuilt.AddDocument(id, join(texts.back()), statuses.back(), ratings.back());
+    }
+
+    const auto check_same = [&](const string& hint) {
+        ASSERT_EQUAL_HINT(updated.GetDocumentCount(), rebuilt.GetDocumentCount(), hint);
+        SearchFilter filter;
+        filter.statuses = {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT};
+        filter.min_rating = 0;
+        filter.max_rating = 4;
+        for (int i = 0; i < 30; ++i) {
+            const string query = GenerateQuery(generator, dictionary, 1 + i % 3, i % 5 == 0 ? 0.3 : 0.0);
+            const vector<pair<vector<Document>, vector<Document>>> results = {
+                {updated.FindTopDocuments(query), rebuilt.FindTopDocuments(query)},
+                {updated.FindTopDocuments(query, DocumentStatus::BANNED), rebuilt.FindTopDocuments(query, DocumentStatus::BANNED)},
+                {updated.FindTopDocuments(execution::par, query), rebuilt.FindTopDocuments(execution::par, query)},
+                {updated.FindTopDocuments(query, filter), rebuilt.FindTopDocuments(query, filter)},
+            };
+            for (const auto& [actual, expected] : results) {
+                ASSERT_EQUAL_HINT(actual.size(), expected.size(), hint + query);
+                for (size_t j = 0; j < expected.size(); ++j) {
+                    ASSERT_EQUAL_HINT(actual[j].id, expected[j].id, hint + query);
+                    ASSERT_HINT(abs(actual[j].relevance - expected[j].relevance) < TOLERANCE, hint + query);
+                    ASSERT_EQUAL_HINT(actual[j].rating, expected[j].rating, hint + query);
+                }
+            }
+            const int document_id = i * 13 % 400;
+            ASSERT_HINT(updated.MatchDocument(query, document_id) == rebuilt.MatchDocument(query, document_id), hint + query);
+        }
+    };
+
+    for (int round = 0; round < 300; ++round) {
+        const int id = uniform_int_distribution<int>(0, 399)(generator);
+        auto& words = texts[id];
+        switch (round % 4) {
+            case 0:
+                // Небольшая правка длинного документа
+                words[uniform_int_distribution<size_t>(0, words.size() - 1)(generator)] = dictionary[round % dictionary.size()];
+                words.push_back(dictionary[(round * 7) % dictionary.size()]);
+                break;
+            case 1:
+                words = {dictionary[round % dictionary.size()], dictionary[(round + 1) % dictionary.size()]};
+                break;
+            case 2:
+                statuses[id] = static_cast<DocumentStatus>((static_cast<int>(statuses[id]) + 1) % DOCUMENT_STATUS_COUNT);
+                break;
+            default:
+                ratings[id] = {round % 9 - 4, round % 5};
+                break;
+        }
+        if (round % 4 >= 2) {
+            updated.UpdateDocument(id, statuses[id], ratings[id]);
+        } else {
+            updated.UpdateDocument(id, join(words), statuses[id], ratings[id]);
+        }
+        rebuilt.RemoveDocument(id);
+        rebuilt.AddDocument(id, join(words), statuses[id], ratings[id]);
+        if (round % 50 == 49) {
+            check_same("round "s + to_string(round) + ": "s);
+        }
+    }
+
+    // Ошибочный текст не меняет документ
+    const auto matched = updated.MatchDocument(texts[1].front(), 1);
+    try {
+        updated.UpdateDocument(1, "bad wo\x12rd"s, DocumentStatus::ACTUAL, {});
+        ASSERT_HINT(false, "Invalid text must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT(updated.MatchDocument(texts[1].front(), 1) == matched);
+    try {
+        updated.UpdateDocument(1000, DocumentStatus::ACTUAL, {});
+        ASSERT_HINT(false, "Missing document must be rejected"s);
+    } catch (const out_of_range&) {
+    }
+}
+
+void TestMatchDocumentBatch() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 300, 6);
+    SearchServer search_server("and in"s);
+    for (int id = 0; id < 500; ++id) {
+        search_server.AddDocument(id * 2, GenerateQuery(generator, dictionary, 20), static_cast<DocumentStatus>(id % DOCUMENT_STATUS_COUNT), {id % 5});
+    }
+
+    vector<MatchedDocuments> results;
+    ThreadPool pool(3);
+    for (int i = 0; i < 20; ++i) {
+        const string query = GenerateQuery(generator, dictionary, 12, 0.1) + " unknown -missing"s;
+        vector<int> document_ids;
+        for (int j = 0; j < (i % 2 == 0 ? 20 : 150); ++j) {
+            document_ids.push_back(uniform_int_distribution<int>(0, 499)(generator) * 2);
+        }
+        if (i % 3 == 0) {
+            search_server.MatchDocuments(pool, query, document_ids, results);
+        } else {
+            search_server.MatchDocuments(query, document_ids, results);
+        }
+        ASSERT_EQUAL(results.size(), document_ids.size());
+        for (size_t j = 0; j < document_ids.size(); ++j) {
+            ASSERT_HINT(results[j] == search_server.MatchDocument(query, document_ids[j]), query);
+        }
+    }
+
+    // Буфер вызывающего переиспользуется, а при ошибке не меняется
+    const auto first_words = get<0>(results.front()).data();
+    search_server.MatchDocuments(dictionary[0], {0}, results);
+    ASSERT_EQUAL(results.size(), 1u);
+    ASSERT(get<0>(results.front()).empty() || get<0>(results.front()).data() == first_words);
+    const auto saved = results;
+    try {
+        search_server.MatchDocuments(dictionary[0], {2, 3}, results);
+        ASSERT_HINT(false, "Missing document must be rejected"s);
+    } catch (const out_of_range&) {
+    }
+    ASSERT(results == saved);
+}
+
 void TestSearchServer() {
     RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
     RUN_TEST(TestExcludeDocumentsWithMinusWords);
@@ -392,6 +1955,34 @@ void TestSearchServer() {
     RUN_TEST(TestUserPredicateToFindDocuments);
     RUN_TEST(TestFindDocumentsWithStatus);
     RUN_TEST(TestCalculationOfRelevanceAddedDocuments);
+    RUN_TEST(TestExplainQuery);
+    RUN_TEST(TestMemoryReport);
+    RUN_TEST(TestPagedSearch);
+    RUN_TEST(TestForwardIndex);
+    RUN_TEST(TestExternalDocumentIds);
+    RUN_TEST(TestRemovedDocumentCompaction);
+    RUN_TEST(TestFindDocumentsByStatusBitmap);
+    RUN_TEST(TestFindDocumentsWithSearchFilter);
+    RUN_TEST(TestConjunctiveQueryMode);
+    RUN_TEST(TestQueryPlanner);
+    RUN_TEST(TestParallelSearchByDocumentRange);
+    RUN_TEST(TestThreadPool);
+    RUN_TEST(TestAsyncRequestQueue);
+    RUN_TEST(TestFindTopDocumentsWithDeadline);
+    RUN_TEST(TestQuantizedImpacts);
+    RUN_TEST(TestImpactOrderedSearch);
+    RUN_TEST(TestTermTopDocuments);
+    RUN_TEST(TestStopWordSet);
+#if defined(__linux__)
+    RUN_TEST(TestDurableSearchServer);
+    RUN_TEST(TestLoadCorpus);
+    RUN_TEST(TestQuerySocketServer);
+#endif
+    RUN_TEST(TestShardedSearchServer);
+    RUN_TEST(TestConcurrentMap);
+    RUN_TEST(TestReorderDocuments);
+    RUN_TEST(TestUpdateDocument);
+    RUN_TEST(TestMatchDocumentBatch);
 }
 
 /*int TestGeneral() {
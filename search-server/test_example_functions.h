@@ -107,6 +107,60 @@ void TestFindDocumentsWithStatus();
 
 void TestCalculationOfRelevanceAddedDocuments();
 
+void TestExplainQuery();
+
+void TestMemoryReport();
+
+void TestPagedSearch();
+
+void TestForwardIndex();
+
+void TestExternalDocumentIds();
+
+void TestRemovedDocumentCompaction();
+
+void TestFindDocumentsByStatusBitmap();
+
+void TestFindDocumentsWithSearchFilter();
+
+void TestConjunctiveQueryMode();
+
+void TestQueryPlanner();
+
+void TestParallelSearchByDocumentRange();
+
+void TestThreadPool();
+
+void TestAsyncRequestQueue();
+
+void TestFindTopDocumentsWithDeadline();
+
+void TestQuantizedImpacts();
+
+void TestImpactOrderedSearch();
+
+void TestTermTopDocuments();
+
+void TestStopWordSet();
+
+#if defined(__linux__)
+void TestDurableSearchServer();
+
+void TestLoadCorpus();
+
+void TestQuerySocketServer();
+#endif
+
+void TestShardedSearchServer();
+
+void TestConcurrentMap();
+
+void TestReorderDocuments();
+
+void TestUpdateDocument();
+
+void TestMatchDocumentBatch();
+
 void TestSearchServer();
 
 int TestGeneral();
@@ -0,0 +1,146 @@
+#include "thread_pool.h"
+
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+void PinCurrentThread(int cpu) {
+#if defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    // Недоступный процессор не делает пул неработоспособным, поэтому ошибка игнорируется
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t thread_count)
+    : ThreadPool(Options{thread_count, {}}) {
+}
+
+ThreadPool::ThreadPool(const Options& options) {
+    for (const int cpu : options.cpu_affinity) {
+        if (cpu < 0) {
+            throw invalid_argument("CPU index must not be negative"s);
+        }
+    }
+
+    const size_t thread_count = options.thread_count > 0 ? options.thread_count : max(thread::hardware_concurrency(), 1u);
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.push_back(make_unique<Worker>());
+    }
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        const int cpu = options.cpu_affinity.empty() ? -1 : options.cpu_affinity[i % options.cpu_affinity.size()];
+        threads_.emplace_back([this, i, cpu] {
+            RunWorker(i, cpu);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard lock(sleep_mutex_);
+        is_stopping_ = true;
+    }
+    wake_up_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::GetThreadCount() const {
+    return threads_.size();
+}
+
+bool ThreadPool::IsWorkerThread() const {
+    return current_pool == this;
+}
+
+bool ThreadPool::IsSaturated() const {
+    return idle_workers_.load() == 0;
+}
+
+ThreadPool& ThreadPool::GetDefault() {
+    static ThreadPool pool(Options{});
+    return pool;
+}
+
+void ThreadPool::Push(Task task) {
+    // Задачи рабочего потока остаются в его очереди, внешние раздаются по кругу
+    const size_t worker_index = IsWorkerThread() ? current_worker : next_worker_.fetch_add(1) % workers_.size();
+    ++pending_tasks_;
+    {
+        auto& worker = *workers_[worker_index];
+        lock_guard lock(worker.mutex);
+        worker.tasks.push_back(move(task));
+    }
+    {
+        lock_guard lock(sleep_mutex_);
+    }
+    wake_up_.notify_one();
+}
+
+bool ThreadPool::TryRunTask(size_t worker_index) {
+    Task task;
+    for (size_t i = 0; i < workers_.size() && !task; ++i) {
+        auto& worker = *workers_[(worker_index + i) % workers_.size()];
+        lock_guard lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = move(worker.tasks.back());
+            worker.tasks.pop_back();
+        } else {
+            task = move(worker.tasks.front());
+            worker.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    --pending_tasks_;
+    task();
+    return true;
+}
+
+void ThreadPool::RunWorker(size_t worker_index, int cpu) {
+    current_pool = this;
+    current_worker = worker_index;
+    if (cpu >= 0) {
+        PinCurrentThread(cpu);
+    }
+
+    while (true) {
+        if (TryRunTask(worker_index)) {
+            continue;
+        }
+        unique_lock lock(sleep_mutex_);
+        ++idle_workers_;
+        wake_up_.wait(lock, [this] {
+            return is_stopping_ || pending_tasks_.load() > 0;
+        });
+        --idle_workers_;
+        if (is_stopping_ && pending_tasks_.load() == 0) {
+            return;
+        }
+    }
+}
+
+size_t ThreadPool::GetCurrentWorker() const {
+    return current_worker;
+}
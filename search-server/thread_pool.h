@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Пул потоков с перехватом задач: у каждого рабочего потока своя очередь,
+// свои задачи он берёт с конца, а простаивая, забирает чужие с начала.
+//
+// Задачи, отправленные из рабочего потока занятого пула, выполняются сразу
+// в этом же потоке, поэтому вложенный параллелизм не приводит ни к переподписке,
+// ни к взаимной блокировке. ParallelFor всегда выполняет часть работы в вызывающем
+// потоке: вызов из стороннего потока (например, индексации) продвигается,
+// даже если все рабочие потоки заняты запросами.
+class ThreadPool {
+public:
+    struct Options {
+        // 0 — по числу аппаратных потоков
+        std::size_t thread_count = 0;
+        // Номера процессоров, к которым по кругу привязываются рабочие потоки; пусто — без привязки.
+        // Привязка — подсказка планировщику ОС и поддерживается только в Linux
+        std::vector<int> cpu_affinity;
+    };
+
+    explicit ThreadPool(std::size_t thread_count);
+    explicit ThreadPool(const Options& options);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Дожидается выполнения всех поставленных задач
+    ~ThreadPool();
+
+    std::size_t GetThreadCount() const;
+
+    bool IsWorkerThread() const;
+
+    // Нет простаивающих рабочих потоков
+    bool IsSaturated() const;
+
+    template <typename Function>
+    std::future<std::invoke_result_t<Function>> Submit(Function function);
+
+    // Вызывает function(index) для каждого index из [begin, end) и дожидается завершения;
+    // первое выброшенное исключение передаётся вызывающему
+    template <typename Function>
+    void ParallelFor(std::size_t begin, std::size_t end, Function function);
+
+    // Общий пул для перегрузок с std::execution::par
+    static ThreadPool& GetDefault();
+
+private:
+    using Task = std::function<void()>;
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_up_;
+    bool is_stopping_ = false;
+    std::atomic<std::size_t> pending_tasks_{0};
+    std::atomic<std::size_t> idle_workers_{0};
+    std::atomic<std::size_t> next_worker_{0};
+
+    void Push(Task task);
+    bool TryRunTask(std::size_t worker_index);
+    void RunWorker(std::size_t worker_index, int cpu);
+
+    std::size_t GetCurrentWorker() const;
+};
+
+template <typename Function>
+std::future<std::invoke_result_t<Function>> ThreadPool::Submit(Function function) {
+    using Result = std::invoke_result_t<Function>;
+
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+    auto result = task->get_future();
+    if (threads_.empty() || (IsWorkerThread() && IsSaturated())) {
+        (*task)();
+    } else {
+        Push([task] {
+            (*task)();
+        });
+    }
+    return result;
+}
+
+template <typename Function>
+void ThreadPool::ParallelFor(std::size_t begin, std::size_t end, Function function) {
+    using namespace std;
+
+    if (begin >= end) {
+        return;
+    }
+    const size_t count = end - begin;
+    if (count == 1 || threads_.empty() || (IsWorkerThread() && IsSaturated())) {
+        for (size_t index = begin; index < end; ++index) {
+            function(index);
+        }
+        return;
+    }
+
+    // Состояние живёт, пока его держат запоздавшие помощники, уже не нашедшие работы
+    struct State {
+        State(Function state_function, size_t state_begin, size_t state_count, size_t state_grain)
+            : function(move(state_function))
+            , begin(state_begin)
+            , count(state_count)
+            , grain(state_grain) {
+        }
+
+        Function function;
+        size_t begin;
+        size_t count;
+        size_t grain;
+        atomic<size_t> next{0};
+        atomic<size_t> done{0};
+        mutex error_mutex;
+        exception_ptr error;
+        mutex done_mutex;
+        condition_variable all_done;
+    };
+    const size_t grain = max<size_t>(1, count / (threads_.size() * 4));
+    const auto state = make_shared<State>(move(function), begin, count, grain);
+
+    const auto run_chunks = [state] {
+        for (size_t first; (first = state->next.fetch_add(state->grain)) < state->count;) {
+            const size_t last = min(first + state->grain, state->count);
+            try {
+                for (size_t index = first; index < last; ++index) {
+                    state->function(state->begin + index);
+                }
+            } catch (...) {
+                lock_guard lock(state->error_mutex);
+                if (!state->error) {
+                    state->error = current_exception();
+                }
+            }
+            if (state->done.fetch_add(last - first) + (last - first) == state->count) {
+                lock_guard lock(state->done_mutex);
+                state->all_done.notify_all();
+            }
+        }
+    };
+
+    const size_t helpers = min((count + grain - 1) / grain - 1, threads_.size());
+    for (size_t i = 0; i < helpers; ++i) {
+        Push(run_chunks);
+    }
+    run_chunks();
+
+    if (IsWorkerThread()) {
+        // Рабочий поток не блокируется, а выполняет чужие задачи, пока ждёт свои
+        while (state->done.load() < count) {
+            if (!TryRunTask(GetCurrentWorker())) {
+                this_thread::yield();
+            }
+        }
+    } else {
+        unique_lock lock(state->done_mutex);
+        state->all_done.wait(lock, [&state, count] {
+            return state->done.load() == count;
+        });
+    }
+
+    if (state->error) {
+        rethrow_exception(state->error);
+    }
+}
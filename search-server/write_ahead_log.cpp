@@ -0,0 +1,409 @@
+#include "write_ahead_log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "binary_encoding.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Длина тела, CRC-32 тела; тело — LSN и данные записи
+const size_t FRAME_HEADER_SIZE = 8;
+const size_t MAX_BATCH_SIZE = 1 << 20;
+
+// Номер первой записи сегмента, записанный на диск размер и CRC-32 этих 16 байт
+const char SYNCED_MARK_NAME[] = "wal.synced";
+const size_t SYNCED_MARK_SIZE = 20;
+
+[[noreturn]] void ThrowSystemError(const string& what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+string GetSegmentName(uint64_t first_lsn) {
+    char name[32];
+    snprintf(name, sizeof(name), "wal-%020llu.log", static_cast<unsigned long long>(first_lsn));
+    return name;
+}
+
+// Сегменты по возрастанию номера первой записи
+vector<pair<uint64_t, fs::path>> ListSegments(const fs::path& directory) {
+    vector<pair<uint64_t, fs::path>> segments;
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        const string name = entry.path().filename().string();
+        unsigned long long first_lsn = 0;
+        int length = 0;
+        if (sscanf(name.c_str(), "wal-%20llu.log%n", &first_lsn, &length) == 1 && length == static_cast<int>(name.size())) {
+            segments.emplace_back(first_lsn, entry.path());
+        }
+    }
+    sort(segments.begin(), segments.end());
+    return segments;
+}
+
+void WriteAll(int file, string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = ::write(file, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("Failed to write log segment"s);
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+}
+
+string MakeSyncedMark(uint64_t first_lsn, size_t synced_size) {
+    string mark;
+    PutFixed64(mark, first_lsn);
+    PutFixed64(mark, synced_size);
+    PutFixed32(mark, ComputeCrc32(mark));
+    return mark;
+}
+
+// Отметка пишется без fsync: после сбоя она может только отстать, и тогда хвостом считается больше
+void WriteSyncedMark(int file, uint64_t first_lsn, size_t synced_size) {
+    const string mark = MakeSyncedMark(first_lsn, synced_size);
+    if (::pwrite(file, mark.data(), mark.size(), 0) != static_cast<ssize_t>(mark.size())) {
+        ThrowSystemError("Failed to write synced log mark"s);
+    }
+}
+
+// Размер сегмента first_lsn, записанный на диск; 0, если отметка относится к другому сегменту или повреждена
+size_t ReadSyncedSize(const fs::path& directory, uint64_t first_lsn) {
+    ifstream input(directory / SYNCED_MARK_NAME, ios::binary);
+    const string mark{istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+    if (mark.size() != SYNCED_MARK_SIZE) {
+        return 0;
+    }
+    BinaryReader reader(mark);
+    const uint64_t mark_lsn = reader.ReadFixed64();
+    const uint64_t synced_size = reader.ReadFixed64();
+    if (reader.ReadFixed32() != ComputeCrc32(string_view(mark).substr(0, 16)) || mark_lsn != first_lsn) {
+        return 0;
+    }
+    return static_cast<size_t>(synced_size);
+}
+
+// Тело целого кадра, начинающегося с position; nullopt, если кадр оборван или не сходится CRC
+optional<string_view> ReadFrameBody(string_view data, size_t position) {
+    const size_t remaining = data.size() - position;
+    if (remaining < FRAME_HEADER_SIZE) {
+        return nullopt;
+    }
+    BinaryReader header(data.substr(position, FRAME_HEADER_SIZE));
+    const uint32_t body_size = header.ReadFixed32();
+    const uint32_t crc = header.ReadFixed32();
+    if (remaining - FRAME_HEADER_SIZE < body_size || body_size < 8) {
+        return nullopt;
+    }
+    const string_view body = data.substr(position + FRAME_HEADER_SIZE, body_size);
+    if (ComputeCrc32(body) != crc) {
+        return nullopt;
+    }
+    return body;
+}
+
+void TruncateDurably(const fs::path& path, size_t size) {
+    const int file = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (file < 0) {
+        ThrowSystemError("Failed to open log segment "s + path.string());
+    }
+    const int result = ::ftruncate(file, static_cast<off_t>(size)) == 0 ? ::fdatasync(file) : -1;
+    const int error = errno;
+    ::close(file);
+    if (result != 0) {
+        throw system_error(error, generic_category(), "Failed to truncate log segment "s + path.string());
+    }
+}
+
+} // namespace
+
+void SyncDirectory(const fs::path& directory) {
+    const int file = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        ThrowSystemError("Failed to open directory "s + directory.string());
+    }
+    const int result = ::fsync(file);
+    ::close(file);
+    if (result != 0) {
+        ThrowSystemError("Failed to sync directory "s + directory.string());
+    }
+}
+
+WriteAheadLog::WriteAheadLog(fs::path directory, uint64_t next_lsn, Options options)
+    : directory_(move(directory))
+    , options_(options)
+    , last_lsn_(next_lsn - 1)
+    , durable_lsn_(next_lsn - 1)
+    , open_segment_lsn_(next_lsn) {
+    const fs::path mark_path = directory_ / SYNCED_MARK_NAME;
+    synced_mark_file_ = ::open(mark_path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (synced_mark_file_ < 0) {
+        ThrowSystemError("Failed to open "s + mark_path.string());
+    }
+    OpenSegment(next_lsn);
+    writer_ = thread([this] {
+        RunWriter();
+    });
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        lock_guard lock(mutex_);
+        is_stopping_ = true;
+    }
+    has_records_.notify_all();
+    writer_.join();
+    ::close(file_);
+    ::close(synced_mark_file_);
+}
+
+uint64_t WriteAheadLog::Append(string_view payload) {
+    string body;
+    body.reserve(payload.size() + 8);
+
+    lock_guard lock(mutex_);
+    ThrowIfFailed();
+    const uint64_t lsn = last_lsn_ + 1;
+    PutFixed64(body, lsn);
+    body.append(payload);
+    PutFixed32(buffer_, static_cast<uint32_t>(body.size()));
+    PutFixed32(buffer_, ComputeCrc32(body));
+    buffer_.append(body);
+    segment_size_ += FRAME_HEADER_SIZE + body.size();
+    last_lsn_ = lsn;
+    has_records_.notify_one();
+    return lsn;
+}
+
+void WriteAheadLog::WaitDurable(uint64_t lsn) {
+    unique_lock lock(mutex_);
+    durable_.wait(lock, [this, lsn] {
+        return durable_lsn_ >= lsn || error_;
+    });
+    ThrowIfFailed();
+}
+
+void WriteAheadLog::Sync() {
+    WaitDurable(GetLastLsn());
+}
+
+uint64_t WriteAheadLog::StartSegment() {
+    lock_guard lock(mutex_);
+    ThrowIfFailed();
+    const uint64_t first_lsn = last_lsn_ + 1;
+    if (segment_starts_.empty() || segment_starts_.back().first_lsn != first_lsn) {
+        segment_starts_.push_back({buffer_.size(), first_lsn});
+    }
+    segment_size_ = 0;
+    has_records_.notify_one();
+    return first_lsn;
+}
+
+void WriteAheadLog::WaitSegment(uint64_t first_lsn) {
+    unique_lock lock(mutex_);
+    durable_.wait(lock, [this, first_lsn] {
+        return open_segment_lsn_ >= first_lsn || error_;
+    });
+    ThrowIfFailed();
+}
+
+void WriteAheadLog::RemoveSegmentsUpTo(uint64_t lsn) {
+    const auto segments = ListSegments(directory_);
+    // Сегмент содержит записи до первой записи следующего; последний сегмент текущий
+    for (size_t i = 0; i + 1 < segments.size() && segments[i + 1].first - 1 <= lsn; ++i) {
+        fs::remove(segments[i].second);
+    }
+    SyncDirectory(directory_);
+}
+
+uint64_t WriteAheadLog::GetLastLsn() const {
+    lock_guard lock(mutex_);
+    return last_lsn_;
+}
+
+size_t WriteAheadLog::GetSegmentSize() const {
+    lock_guard lock(mutex_);
+    return segment_size_;
+}
+
+uint64_t WriteAheadLog::Recover(const fs::path& directory, uint64_t after_lsn,
+                                const function<void(uint64_t lsn, string_view payload)>& apply) {
+    const auto segments = ListSegments(directory);
+    uint64_t last_lsn = after_lsn;
+    // Номер следующей записи журнала; первый сегмент не может начинаться позже записи после контрольной точки
+    uint64_t next_lsn = segments.empty() ? after_lsn + 1 : min(segments.front().first, after_lsn + 1);
+    for (size_t index = 0; index < segments.size(); ++index) {
+        const auto& [first_lsn, path] = segments[index];
+        if (first_lsn != next_lsn) {
+            throw CorruptedDataError("Log records before "s + path.string() + " are missing"s);
+        }
+        ifstream input(path, ios::binary);
+        const string data{istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+
+        // Сегмент начинается только после fdatasync предыдущего, так что до конца записаны все, кроме последнего
+        const bool is_last = index + 1 == segments.size();
+        const size_t synced_size = is_last ? ReadSyncedSize(directory, first_lsn) : data.size();
+
+        size_t position = 0;
+        while (position < data.size()) {
+            const auto body = ReadFrameBody(data, position);
+            const bool is_next = body && BinaryReader(*body).ReadFixed64() == next_lsn;
+            if (!is_next) {
+                // Пакет, не дождавшийся fdatasync, мог попасть на диск частично и не по порядку:
+                // нули и мусор в нём допустимы, а ни одна его запись не была подтверждена
+                if (position < synced_size) {
+                    throw CorruptedDataError("Corrupted log record in synced part of "s + path.string());
+                }
+                TruncateDurably(path, position);
+                break;
+            }
+            ++next_lsn;
+            const uint64_t lsn = next_lsn - 1;
+            if (lsn > last_lsn) {
+                apply(lsn, body->substr(8));
+                last_lsn = lsn;
+            }
+            position += FRAME_HEADER_SIZE + body->size();
+        }
+    }
+    return last_lsn;
+}
+
+void WriteAheadLog::ReadRecords(const fs::path& directory, uint64_t after_lsn, uint64_t up_to_lsn,
+                                const function<void(uint64_t lsn, string_view payload)>& apply) {
+    if (up_to_lsn <= after_lsn) {
+        return;
+    }
+    const auto segments = ListSegments(directory);
+    // Первый нужный сегмент — последний, начинающийся не позже записи after_lsn + 1
+    size_t index = 0;
+    while (index + 1 < segments.size() && segments[index + 1].first <= after_lsn + 1) {
+        ++index;
+    }
+    if (segments.empty() || segments[index].first > after_lsn + 1) {
+        throw CorruptedDataError("Log record "s + to_string(after_lsn + 1) + " is missing"s);
+    }
+
+    uint64_t next_lsn = segments[index].first;
+    for (; index < segments.size() && next_lsn <= up_to_lsn; ++index) {
+        const auto& [first_lsn, path] = segments[index];
+        if (first_lsn != next_lsn) {
+            throw CorruptedDataError("Log records before "s + path.string() + " are missing"s);
+        }
+        ifstream input(path, ios::binary);
+        const string data{istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+        size_t position = 0;
+        while (position < data.size() && next_lsn <= up_to_lsn) {
+            const auto body = ReadFrameBody(data, position);
+            if (!body || BinaryReader(*body).ReadFixed64() != next_lsn) {
+                throw CorruptedDataError("Corrupted log record in "s + path.string());
+            }
+            if (next_lsn > after_lsn) {
+                apply(next_lsn, body->substr(8));
+            }
+            ++next_lsn;
+            position += FRAME_HEADER_SIZE + body->size();
+        }
+    }
+    if (next_lsn <= up_to_lsn) {
+        throw CorruptedDataError("Log record "s + to_string(next_lsn) + " is missing"s);
+    }
+}
+
+void WriteAheadLog::OpenSegment(uint64_t first_lsn) {
+    const fs::path path = directory_ / GetSegmentName(first_lsn);
+    file_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (file_ < 0) {
+        ThrowSystemError("Failed to open log segment "s + path.string());
+    }
+    SyncDirectory(directory_);
+    segment_first_lsn_ = first_lsn;
+    synced_size_ = 0;
+}
+
+void WriteAheadLog::RunWriter() {
+    unique_lock lock(mutex_);
+    while (true) {
+        has_records_.wait(lock, [this] {
+            return is_stopping_ || !buffer_.empty() || !segment_starts_.empty();
+        });
+        if (buffer_.empty() && segment_starts_.empty()) {
+            return;
+        }
+        // Окно групповой фиксации: записи, добавленные за это время, попадут под тот же fsync
+        if (!is_stopping_ && options_.group_commit_delay.count() > 0) {
+            has_records_.wait_for(lock, options_.group_commit_delay, [this] {
+                return is_stopping_ || buffer_.size() >= MAX_BATCH_SIZE;
+            });
+        }
+
+        string batch;
+        batch.swap(buffer_);
+        vector<SegmentStart> segment_starts;
+        segment_starts.swap(segment_starts_);
+        const uint64_t batch_lsn = last_lsn_;
+        lock.unlock();
+
+        exception_ptr error;
+        try {
+            WriteBatch(batch, segment_starts);
+        } catch (...) {
+            error = current_exception();
+        }
+
+        lock.lock();
+        if (error) {
+            error_ = error;
+        } else {
+            durable_lsn_ = batch_lsn;
+            open_segment_lsn_ = segment_first_lsn_;
+        }
+        durable_.notify_all();
+        if (error_) {
+            return;
+        }
+    }
+}
+
+void WriteAheadLog::WriteBatch(string_view batch, const vector<SegmentStart>& segment_starts) {
+    size_t begin = 0;
+    for (size_t index = 0; index <= segment_starts.size(); ++index) {
+        const size_t end = index < segment_starts.size() ? segment_starts[index].offset : batch.size();
+        if (end > begin) {
+            WriteAll(file_, batch.substr(begin, end - begin));
+            if (::fdatasync(file_) != 0) {
+                ThrowSystemError("Failed to sync log segment"s);
+            }
+            synced_size_ += end - begin;
+            WriteSyncedMark(synced_mark_file_, segment_first_lsn_, synced_size_);
+        }
+        if (index < segment_starts.size()) {
+            // Новый файл появляется только после fdatasync старого, поэтому оборваться может лишь последний сегмент
+            ::close(file_);
+            file_ = -1;
+            OpenSegment(segment_starts[index].first_lsn);
+        }
+        begin = end;
+    }
+}
+
+void WriteAheadLog::ThrowIfFailed() const {
+    if (error_) {
+        rethrow_exception(error_);
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// fsync каталога, чтобы созданные и переименованные файлы пережили сбой
+void SyncDirectory(const std::filesystem::path& directory);
+
+// Журнал предзаписи: записи с номерами (LSN) подряд, разбитые на сегменты wal-<номер первой записи>.log.
+// Append только копирует запись в буфер. Отдельный поток дописывает накопленный буфер
+// в сегмент одним write и одним fdatasync (групповая фиксация), поэтому ни добавление,
+// ни чтение индекса не ждут диска; кому нужна надёжность, ждёт её в WaitDurable.
+// Кадр записи: длина, CRC-32 и LSN. После каждого fdatasync в файл wal.synced записывается,
+// до какого смещения текущий сегмент уже на диске: только хвост после этой отметки мог
+// записаться после сбоя не целиком и не по порядку
+class WriteAheadLog {
+public:
+    struct Options {
+        // Сколько поток записи собирает новые записи перед fsync
+        std::chrono::microseconds group_commit_delay{500};
+    };
+
+    // Новые записи получают номера с next_lsn и пишутся в новый сегмент
+    WriteAheadLog(std::filesystem::path directory, std::uint64_t next_lsn, Options options);
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Записывает на диск всё добавленное
+    ~WriteAheadLog();
+
+    std::uint64_t Append(std::string_view payload);
+
+    // Ждёт, пока запись lsn и все предыдущие окажутся на диске;
+    // бросает std::system_error, если журнал не удалось записать
+    void WaitDurable(std::uint64_t lsn);
+    void Sync();
+
+    // Следующие записи пойдут в новый сегмент; возвращает номер его первой записи.
+    // Не ждёт диска: поток записи откроет новый файл после fdatasync записей старого
+    std::uint64_t StartSegment();
+    // Ждёт, пока поток записи откроет сегмент first_lsn: все более ранние записи тогда на диске,
+    // а их сегменты больше не меняются; бросает std::system_error, если журнал не удалось записать
+    void WaitSegment(std::uint64_t first_lsn);
+    // Удаляет сегменты, все записи которых не новее lsn
+    void RemoveSegmentsUpTo(std::uint64_t lsn);
+
+    std::uint64_t GetLastLsn() const;
+    // Байты, добавленные в текущий сегмент
+    std::size_t GetSegmentSize() const;
+
+    // Передаёт записи новее after_lsn в порядке номеров и обрезает последний сегмент по первому
+    // повреждённому кадру после отметки wal.synced. Бросает CorruptedDataError, если повреждён кадр,
+    // записанный до отметки или в более раннем сегменте, или в номерах пропуск.
+    // Возвращает номер последней записи журнала или after_lsn, если новее записей нет
+    static std::uint64_t Recover(const std::filesystem::path& directory, std::uint64_t after_lsn,
+                                 const std::function<void(std::uint64_t lsn, std::string_view payload)>& apply);
+
+    // Передаёт записи (after_lsn, up_to_lsn], уже записанные на диск, ничего не меняя в журнале;
+    // бросает CorruptedDataError, если какой-то из них нет или её кадр повреждён
+    static void ReadRecords(const std::filesystem::path& directory, std::uint64_t after_lsn, std::uint64_t up_to_lsn,
+                            const std::function<void(std::uint64_t lsn, std::string_view payload)>& apply);
+
+private:
+    // Смещение в буфере, с которого записи идут в новый сегмент
+    struct SegmentStart {
+        std::size_t offset;
+        std::uint64_t first_lsn;
+    };
+
+    const std::filesystem::path directory_;
+    const Options options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable has_records_;
+    std::condition_variable durable_;
+    std::string buffer_;
+    std::vector<SegmentStart> segment_starts_;
+    std::uint64_t last_lsn_;
+    std::uint64_t durable_lsn_;
+    std::size_t segment_size_ = 0;
+    // Первая запись сегмента, открытого потоком записи
+    std::uint64_t open_segment_lsn_;
+    bool is_stopping_ = false;
+    std::exception_ptr error_;
+
+    // Файл текущего сегмента после конструктора меняет только поток записи
+    int file_ = -1;
+    int synced_mark_file_ = -1;
+    std::uint64_t segment_first_lsn_ = 0;
+    // Байты текущего сегмента, записанные на диск
+    std::size_t synced_size_ = 0;
+
+    std::thread writer_;
+
+    void OpenSegment(std::uint64_t first_lsn);
+    void RunWriter();
+    void WriteBatch(std::string_view batch, const std::vector<SegmentStart>& segment_starts);
+    void ThrowIfFailed() const;
+};